@@ -0,0 +1,61 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "allocationcounter.h"
+
+#include <stddef.h>
+
+#if defined(__GLIBC__)
+// Count every heap allocation of the process, Qt allocates the data of its
+// containers and strings with malloc() and not with operator new
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+// Incremented by every thread allocating memory
+static qint64 allocation_count = 0;
+
+extern "C" void *malloc(size_t size)
+{
+    __sync_fetch_and_add(&allocation_count, 1);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    __sync_fetch_and_add(&allocation_count, 1);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    __sync_fetch_and_add(&allocation_count, 1);
+    return __libc_realloc(ptr, size);
+}
+
+qint64 allocationCount()
+{
+    return __sync_fetch_and_add(&allocation_count, 0);
+}
+#else
+qint64 allocationCount()
+{
+    return -1;
+}
+#endif
@@ -0,0 +1,921 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "benchmark.h"
+#include "parser.h"
+#include "tagsource.h"
+#include "tagcache.h"
+#include "tagindex.h"
+#include "calendar.h"
+#include "tokenizer.h"
+#include "patternmatcher.h"
+#include "rule.h"
+#include "token.h"
+#include "utils.h"
+#include "sparqlemitter.h"
+
+#include "pass_splitunits.h"
+#include "pass_numbers.h"
+#include "pass_filesize.h"
+#include "pass_typehints.h"
+#include "pass_properties.h"
+#include "pass_datevalues.h"
+#include "pass_periodnames.h"
+#include "pass_dateperiods.h"
+
+#include <nepomuk2/resourcemanager.h>
+#include <soprano/model.h>
+#include <soprano/queryresultiterator.h>
+#include <soprano/nao.h>
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSet>
+#include <QStringList>
+#include <QTextStream>
+#include <QVector>
+
+#include <stdio.h>
+
+#ifdef COUNT_ALLOCATIONS
+#include "allocationcounter.h"
+#else
+// Allocations are only counted by the benchmark program
+static qint64 allocationCount()
+{
+    return -1;
+}
+#endif
+
+static QString tagLabel(int i)
+{
+    static const char *words[] = {
+        "Project", "holidays", "Family", "work", "Music", "invoice", "Photos", "draft"
+    };
+
+    return QString::fromLatin1("%1 %2").arg(QLatin1String(words[i % 8])).arg(i);
+}
+
+static void printTiming(QTextStream &out, const char *name, qint64 nsecs, int count)
+{
+    out << name << ": " << (nsecs / count) << " ns per lookup\n";
+}
+
+int benchmarkTags(int tag_count)
+{
+    QTextStream out(stdout);
+    QElapsedTimer timer;
+    MemoryTagSource source;
+
+    // Local stand-in for the Nepomuk model
+    for (int i=0; i<tag_count; ++i) {
+        source.setTag(QUrl(QString::fromLatin1("nepomuk:/res/tag%1").arg(i)), tagLabel(i));
+    }
+
+    // Index built from the model
+    TagIndex index;
+
+    timer.start();
+    index.reset(source.loadTags());
+
+    out << "tags: " << index.count() << "\n";
+    out << "index build: " << timer.elapsed() << " ms\n";
+    out << "index memory: " << (index.memoryUsage() / 1024) << " KiB ("
+        << (index.memoryUsage() / qMax(tag_count, 1)) << " bytes per tag)\n";
+
+    // Lookups, through the cache used by the parser
+    static const int lookups = 100000;
+    TagCache cache(&source);
+    QStringList labels;
+    QStringList lower_labels;
+    QStringList prefixes;
+    int found = 0;
+
+    cache.tag(QString());      // Load the cache before measuring
+
+    for (int i=0; i<lookups; ++i) {
+        QString label = tagLabel((i * 7919) % qMax(tag_count, 1));
+
+        labels.append(label);
+        lower_labels.append(label.toLower());
+        prefixes.append(label.left(label.size() - 2));
+    }
+
+    timer.start();
+    for (int i=0; i<lookups; ++i) {
+        found += !cache.tag(labels.at(i)).isEmpty();
+    }
+    printTiming(out, "exact", timer.nsecsElapsed(), lookups);
+
+    timer.start();
+    for (int i=0; i<lookups; ++i) {
+        found += !cache.tag(lower_labels.at(i), Qt::CaseInsensitive).isEmpty();
+    }
+    printTiming(out, "case-insensitive", timer.nsecsElapsed(), lookups);
+
+    timer.start();
+    for (int i=0; i<lookups; ++i) {
+        found += cache.tagsWithPrefix(prefixes.at(i), 10).count();
+    }
+    printTiming(out, "prefix (10 results)", timer.nsecsElapsed(), lookups);
+
+    timer.start();
+    for (int i=0; i<lookups; ++i) {
+        found += !cache.tag(labels.at(i) + QLatin1String("x")).isEmpty();
+    }
+    printTiming(out, "miss", timer.nsecsElapsed(), lookups);
+
+    // Incremental updates
+    static const int updates = 1000;
+
+    timer.start();
+    for (int i=0; i<updates; ++i) {
+        source.setTag(QUrl(QString::fromLatin1("nepomuk:/res/tag%1").arg(i)), tagLabel(i) + QLatin1String(" renamed"));
+    }
+    out << "rename: " << (timer.nsecsElapsed() / updates / 1000) << " us per update\n";
+
+    out << "found: " << found << "\n";
+
+    return 0;
+}
+
+int benchmarkTyping(const QString &query)
+{
+    QTextStream out(stdout);
+    QElapsedTimer timer;
+    Parser parser;
+    ParseSession session(parser);
+    QStringList texts;
+    QVector<Nepomuk2::Query::Query> full_results;
+    int mismatches = 0;
+
+    // Every prefix of the query, as typed one character at a time
+    for (int i=1; i<=query.size(); ++i) {
+        texts.append(query.left(i));
+    }
+
+    if (texts.isEmpty()) {
+        return 1;
+    }
+
+    parser.parse(query);        // Load the tags and translations before measuring
+
+    timer.start();
+    Q_FOREACH(const QString &text, texts) {
+        full_results.append(parser.parse(text));
+    }
+    out << "full parse: " << (timer.nsecsElapsed() / texts.count() / 1000) << " us per keystroke\n";
+
+    timer.start();
+    for (int i=0; i<texts.count(); ++i) {
+        mismatches += !(session.update(texts.at(i)) == full_results.at(i));
+    }
+    out << "session: " << (timer.nsecsElapsed() / texts.count() / 1000) << " us per keystroke\n";
+
+    // Results depending on the current time may differ between the two runs
+    out << "different results: " << mismatches << "\n";
+
+    return 0;
+}
+
+/*
+ * Per-pass benchmarks. Each case runs a pass (or another step of the parser)
+ * on a small curated corpus and returns the number of terms it processed.
+ */
+static const char *corpus[] = {
+    "mails sent by john last monday",
+    "files larger than 10 MB modified yesterday",
+    "images tagged holidays",
+    "documents created before june 6 2013 at 14:30",
+    "music of 3.5kb or larger",
+    "emails received from alice on the 2nd of may",
+    "related to project report, created last week",
+    "twelve documents tagged Project larger than 2 gb",
+    "presentation -draft (work or family)",
+    "mails sent to bob in 2012 containing invoice"
+};
+static const int corpus_size = int(sizeof(corpus) / sizeof(corpus[0]));
+
+static QVector<Token> stringTokens(const char *words)
+{
+    QVector<Token> rs;
+
+    Q_FOREACH(const QString &word, QString::fromLatin1(words).split(QLatin1Char(' '))) {
+        rs.append(Token::fromString(word));
+    }
+
+    return rs;
+}
+
+static QVector<Token> singleToken(const Token &token)
+{
+    return QVector<Token>() << token;
+}
+
+template<typename P>
+struct PassCase {
+    PassCase(const P &pass, const QList<QVector<Token> > &matches)
+    : pass(pass), matches(matches)
+    {}
+
+    int run() const
+    {
+        int terms = 0;
+
+        Q_FOREACH(const QVector<Token> &match, matches) {
+            terms += match.count() + pass.run(match).count();
+        }
+
+        return terms;
+    }
+
+    const P &pass;
+    QList<QVector<Token> > matches;
+};
+
+struct DateValuesCase {
+    DateValuesCase(const PassDateValues &pass, const QList<QVector<Token> > &matches)
+    : pass(pass), matches(matches)
+    {}
+
+    int run() const
+    {
+        int terms = 0;
+
+        Q_FOREACH(const QVector<Token> &match, matches) {
+            terms += match.count() + pass.run(match, false).count();
+        }
+
+        return terms;
+    }
+
+    const PassDateValues &pass;
+    QList<QVector<Token> > matches;
+};
+
+struct PropertiesCase {
+    PropertiesCase(const PassProperties &pass, const QList<QVector<Token> > &matches)
+    : pass(pass), matches(matches)
+    {}
+
+    int run() const
+    {
+        int terms = 0;
+
+        Q_FOREACH(const QVector<Token> &match, matches) {
+            terms += match.count() +
+                     pass.run(match, Soprano::Vocabulary::NAO::hasTag(), PassProperties::Tag).count();
+        }
+
+        return terms;
+    }
+
+    const PassProperties &pass;
+    QList<QVector<Token> > matches;
+};
+
+struct TokenizerCase {
+    explicit TokenizerCase(const Tokenizer &tokenizer)
+    : tokenizer(tokenizer)
+    {}
+
+    int run() const
+    {
+        int terms = 0;
+
+        for (int i=0; i<corpus_size; ++i) {
+            terms += tokenizer.tokenize(QString::fromLatin1(corpus[i]), true).count();
+        }
+
+        return terms;
+    }
+
+    const Tokenizer &tokenizer;
+};
+
+// Matches a rule without replacing anything, only the matcher is measured
+struct NullPass {
+    QVector<Token> run(const QVector<Token> &) const
+    {
+        return QVector<Token>();
+    }
+};
+
+struct MatcherCase {
+    MatcherCase(const Rule &rule)
+    : rule(rule)
+    {
+        for (int i=0; i<corpus_size; ++i) {
+            queries.append(stringTokens(corpus[i]));
+        }
+    }
+
+    int run() const
+    {
+        int terms = 0;
+
+        Q_FOREACH(const QVector<Token> &query, queries) {
+            QVector<Token> tokens = query;
+            PatternMatcher matcher(tokens, rule);
+
+            matcher.runPass(NullPass());
+            terms += tokens.count();
+        }
+
+        return terms;
+    }
+
+    const Rule &rule;
+    QList<QVector<Token> > queries;
+};
+
+struct FuseCase {
+    FuseCase(const Calendar &calendar, const QList<QVector<Token> > &queries)
+    : calendar(calendar), queries(queries)
+    {}
+
+    int run() const
+    {
+        int terms = 0;
+
+        Q_FOREACH(const QVector<Token> &query, queries) {
+            int end_index;
+
+            fuseTerms(query, 0, end_index, calendar, keywords);
+            terms += query.count();
+        }
+
+        return terms;
+    }
+
+    const Calendar &calendar;
+    FuseKeywords keywords;
+    QList<QVector<Token> > queries;
+};
+
+struct ParseCase {
+    explicit ParseCase(const Parser &parser)
+    : parser(parser)
+    {}
+
+    int run() const
+    {
+        for (int i=0; i<corpus_size; ++i) {
+            parser.parse(QString::fromLatin1(corpus[i]));
+        }
+
+        return corpus_size;
+    }
+
+    const Parser &parser;
+};
+
+struct SparqlCase {
+    SparqlCase(const Parser &parser, bool direct)
+    : parser(parser), direct(direct)
+    {}
+
+    int run() const
+    {
+        for (int i=0; i<corpus_size; ++i) {
+            QString query = QString::fromLatin1(corpus[i]);
+
+            if (direct) {
+                parser.parseSparql(query);
+            } else {
+                parser.parse(query).toSparqlQuery();
+            }
+        }
+
+        return corpus_size;
+    }
+
+    const Parser &parser;
+    bool direct;
+};
+
+template<typename T>
+static void measure(QTextStream &out, const char *name, const T &bench, int iterations, int queries)
+{
+    QElapsedTimer timer;
+    qint64 terms = 0;
+
+    bench.run();        // Warm up the caches of the pass
+
+    qint64 first_allocation = allocationCount();
+
+    timer.start();
+    for (int i=0; i<iterations; ++i) {
+        terms += bench.run();
+    }
+
+    qint64 nsecs = timer.nsecsElapsed();
+    qint64 allocations = allocationCount() - first_allocation;
+    qint64 count = qint64(iterations) * queries;
+
+    out << name << ": " << (nsecs / count) << " ns/query, ";
+
+    if (first_allocation >= 0) {
+        out << (double(allocations) / count) << " allocations/query, ";
+    }
+
+    out << (double(terms) / count) << " terms/query\n";
+}
+
+int benchmarkPasses(int iterations)
+{
+    QTextStream out(stdout);
+
+    // Deterministic stand-in for the Nepomuk model
+    MemoryTagSource tags;
+
+    tags.setTag(QUrl(QLatin1String("nepomuk:/res/tag-holidays")), QLatin1String("holidays"));
+    tags.setTag(QUrl(QLatin1String("nepomuk:/res/tag-project")), QLatin1String("Project"));
+    tags.setTag(QUrl(QLatin1String("nepomuk:/res/tag-work")), QLatin1String("work"));
+
+    // Inputs of the passes, as given to them by the matchers
+    PassSplitUnits splitunits;
+    PassNumbers numbers;
+    PassFileSize filesize;
+    PassTypeHints typehints;
+    PassProperties properties;
+    PassDateValues datevalues;
+    PassPeriodNames periodnames;
+
+    properties.setTagSource(&tags);
+
+    QList<QVector<Token> > words;
+
+    words << stringTokens("10kb") << stringTokens("3.5MB") << stringTokens("report")
+          << stringTokens("2gb") << stringTokens("14:30");
+
+    QList<QVector<Token> > numbers_matches;
+
+    numbers_matches << stringTokens("twelve") << stringTokens("123") << stringTokens("3.14")
+                    << stringTokens("invoice");
+
+    QList<QVector<Token> > filesize_matches;
+
+    filesize_matches << (QVector<Token>() << Token::fromInteger(10) << Token::fromString(QLatin1String("MB")))
+                     << (QVector<Token>() << Token::fromDouble(3.5) << Token::fromString(QLatin1String("kb")))
+                     << (QVector<Token>() << Token::fromInteger(2) << Token::fromString(QLatin1String("files")));
+
+    QList<QVector<Token> > typehints_matches;
+
+    typehints_matches << stringTokens("mails") << stringTokens("images") << stringTokens("music")
+                      << stringTokens("john");
+
+    QList<QVector<Token> > tag_matches;
+
+    tag_matches << stringTokens("holidays") << stringTokens("project") << stringTokens("unknown");
+
+    QList<QVector<Token> > datevalues_matches;
+    QVector<Token> date(7);     // Year, month, day, day of week, hour, minute, second
+
+    date[0] = Token::fromInteger(2013);
+    date[1] = Token::fromInteger(6);
+    date[2] = Token::fromInteger(6);
+    datevalues_matches << date;
+
+    QVector<Token> time(7);
+
+    time[4] = Token::fromInteger(14);
+    time[5] = Token::fromInteger(30);
+    datevalues_matches << time;
+
+    QList<QVector<Token> > periodnames_matches;
+
+    periodnames_matches << stringTokens("monday") << stringTokens("june") << stringTokens("report");
+
+    // Rule exercising literals, alternations and placeholders
+    Rule rule;
+    QList<PatternAtom> atoms;
+
+    atoms << PatternAtom(QLatin1String("(larger|bigger|smaller)"))
+          << PatternAtom(QLatin1String("than"))
+          << PatternAtom(QLatin1String("%1"));
+    rule.addPattern(Pattern(atoms));
+    atoms.clear();
+    atoms << PatternAtom(QLatin1String("sent"))
+          << PatternAtom(QLatin1String("(by|to)"))
+          << PatternAtom(QLatin1String("%1"));
+    rule.addPattern(Pattern(atoms));
+
+    // Token lists as they are before being fused
+    Calendar calendar;
+    QList<QVector<Token> > fuse_queries;
+
+    for (int i=0; i<corpus_size; ++i) {
+        fuse_queries.append(stringTokens(corpus[i]));
+    }
+
+    fuse_queries.last().append(Token::fromDateTime(QDateTime(QDate(2013, 6, 6), QTime(14, 30))));
+    fuse_queries.last().append(Token::fromInteger(1000));
+
+    // Whole pipeline
+    Parser parser;
+
+    parser.setTagSource(&tags);
+
+    out << "iterations: " << iterations << "\n";
+
+    measure(out, "tokenizer", TokenizerCase(Tokenizer(QLatin1String(",;:!?()[]{}<>=#+-"))), iterations, corpus_size);
+    measure(out, "PassSplitUnits", PassCase<PassSplitUnits>(splitunits, words), iterations, words.count());
+    measure(out, "PassNumbers", PassCase<PassNumbers>(numbers, numbers_matches), iterations, numbers_matches.count());
+    measure(out, "PassFileSize", PassCase<PassFileSize>(filesize, filesize_matches), iterations, filesize_matches.count());
+    measure(out, "PassTypeHints", PassCase<PassTypeHints>(typehints, typehints_matches), iterations, typehints_matches.count());
+    measure(out, "PassPeriodNames", PassCase<PassPeriodNames>(periodnames, periodnames_matches), iterations, periodnames_matches.count());
+    measure(out, "PassDateValues", DateValuesCase(datevalues, datevalues_matches), iterations, datevalues_matches.count());
+    measure(out, "PassProperties (tags)", PropertiesCase(properties, tag_matches), iterations, tag_matches.count());
+    measure(out, "PatternMatcher", MatcherCase(rule), iterations, corpus_size);
+    measure(out, "fuseTerms", FuseCase(calendar, fuse_queries), iterations, fuse_queries.count());
+    measure(out, "Parser::parse", ParseCase(parser), iterations, corpus_size);
+    measure(out, "Query::toSparqlQuery", SparqlCase(parser, false), iterations, corpus_size);
+    measure(out, "Parser::parseSparql", SparqlCase(parser, true), iterations, corpus_size);
+
+    return 0;
+}
+
+/*
+ * Built-in rules, they must give the same queries as the rules translated
+ * and compiled at runtime
+ */
+static bool readCorpus(const QString &corpus_path, QTextStream &out, QStringList &queries)
+{
+    if (corpus_path.isEmpty()) {
+        for (int i=0; i<corpus_size; ++i) {
+            queries.append(QString::fromLatin1(corpus[i]));
+        }
+
+        return true;
+    }
+
+    QFile file(corpus_path);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        out << "unable to open " << corpus_path << "\n";
+        return false;
+    }
+
+    QTextStream in(&file);
+
+    while (!in.atEnd()) {
+        queries.append(in.readLine());
+    }
+
+    return true;
+}
+
+int checkBuiltinRules(const QString &corpus_path)
+{
+    QTextStream out(stdout);
+    QStringList queries;
+
+    if (!readCorpus(corpus_path, out, queries)) {
+        return 1;
+    }
+
+#ifndef HAVE_BUILTIN_RULES
+    out << "warning: built without builtinrules.cpp, both parsers translate their rules\n";
+#endif
+
+    Parser builtin;
+    Parser translated(Parser::TranslatedRules);
+
+    // Same reference time for both parsers
+    QDateTime reference_time(QDate(2013, 6, 13), QTime(12, 0));
+    int mismatches = 0;
+
+    Q_FOREACH(const QString &query, queries) {
+        if (!(builtin.parse(query, reference_time) == translated.parse(query, reference_time))) {
+            out << "different result: " << query << "\n";
+            ++mismatches;
+        }
+    }
+
+    out << "queries: " << queries.count() << "\n";
+    out << "different results: " << mismatches << "\n";
+
+    return (mismatches == 0 ? 0 : 1);
+}
+
+/*
+ * Matching modes, the rules must keep their priority when the patterns of a
+ * stage are matched together
+ */
+int checkMatchingModes(const QString &corpus_path)
+{
+    QTextStream out(stdout);
+    QStringList queries;
+
+    if (!readCorpus(corpus_path, out, queries)) {
+        return 1;
+    }
+
+    // Patterns of different rules overlapping, the earlier rule wins
+    queries << QLatin1String("title from bob")
+            << QLatin1String("sent to alice sent by bob");
+
+    Parser sequential;
+    Parser stage;
+
+    sequential.setMatchingMode(Parser::SequentialMatching);
+    stage.setMatchingMode(Parser::StageMatching);
+
+    QDateTime reference_time(QDate(2013, 6, 13), QTime(12, 0));
+    int mismatches = 0;
+
+    Q_FOREACH(const QString &query, queries) {
+        if (!(sequential.parse(query, reference_time) == stage.parse(query, reference_time))) {
+            out << "different result: " << query << "\n";
+            ++mismatches;
+        }
+    }
+
+    out << "queries: " << queries.count() << "\n";
+    out << "different results: " << mismatches << "\n";
+
+    return (mismatches == 0 ? 0 : 1);
+}
+
+/*
+ * Intervals compared with the date-times, they last the finest period
+ * given in the date-time (encoded in its milliseconds)
+ */
+static int checkInterval(QTextStream &out,
+                         const Calendar &calendar,
+                         PassDatePeriods::Period period,
+                         const QDateTime &start,
+                         const QDateTime &expected_end)
+{
+    QTime start_time(start.time().hour(), start.time().minute(), start.time().second(), period);
+    QTime end_time(expected_end.time().hour(), expected_end.time().minute(), expected_end.time().second(), period);
+    QDateTime start_date_time;
+    QDateTime end_date_time;
+
+    dateTimeInterval(Token::fromDateTime(QDateTime(start.date(), start_time)), calendar, start_date_time, end_date_time);
+
+    if (end_date_time == QDateTime(expected_end.date(), end_time)) {
+        return 0;
+    }
+
+    out << "wrong interval: " << PassDatePeriods::nameOfPeriod(period) << " from " << start.toString(Qt::ISODate)
+        << " ends at " << end_date_time.toString(Qt::ISODate)
+        << " instead of " << expected_end.toString(Qt::ISODate) << "\n";
+
+    return 1;
+}
+
+int checkIntervals()
+{
+    QTextStream out(stdout);
+    Calendar calendar;
+    int failures = 0;
+
+    // Hours, minutes and seconds, also across midnight
+    failures += checkInterval(out, calendar, PassDatePeriods::Hour,
+        QDateTime(QDate(2013, 6, 13), QTime(14, 0)), QDateTime(QDate(2013, 6, 13), QTime(15, 0)));
+    failures += checkInterval(out, calendar, PassDatePeriods::Hour,
+        QDateTime(QDate(2013, 6, 13), QTime(23, 0)), QDateTime(QDate(2013, 6, 14), QTime(0, 0)));
+    failures += checkInterval(out, calendar, PassDatePeriods::Minute,
+        QDateTime(QDate(2013, 6, 13), QTime(14, 30)), QDateTime(QDate(2013, 6, 13), QTime(14, 31)));
+    failures += checkInterval(out, calendar, PassDatePeriods::Second,
+        QDateTime(QDate(2013, 6, 13), QTime(23, 59, 59)), QDateTime(QDate(2013, 6, 14), QTime(0, 0)));
+
+    // Weeks last seven days whatever their first day
+    failures += checkInterval(out, calendar, PassDatePeriods::Week,
+        QDateTime(QDate(2013, 6, 10), QTime(0, 0)), QDateTime(QDate(2013, 6, 17), QTime(0, 0)));
+    failures += checkInterval(out, calendar, PassDatePeriods::Week,
+        QDateTime(QDate(2013, 6, 13), QTime(0, 0)), QDateTime(QDate(2013, 6, 20), QTime(0, 0)));
+
+    failures += checkInterval(out, calendar, PassDatePeriods::Day,
+        QDateTime(QDate(2013, 6, 30), QTime(0, 0)), QDateTime(QDate(2013, 7, 1), QTime(0, 0)));
+    failures += checkInterval(out, calendar, PassDatePeriods::Month,
+        QDateTime(QDate(2013, 12, 1), QTime(0, 0)), QDateTime(QDate(2014, 1, 1), QTime(0, 0)));
+
+    out << "wrong intervals: " << failures << "\n";
+
+    return (failures == 0 ? 0 : 1);
+}
+
+/*
+ * Text written by SparqlEmitter for tokens already matched by the rules, it
+ * is compared without a Nepomuk storage
+ */
+static QString containsPattern(const char *subject, int object, const char *text)
+{
+    // "?r ?v2 ?v1 . ?v1 bif:contains "'text*'" . ", the property is a variable
+    return QString::fromLatin1("%1 ?v%2 ?v%3 . ?v%3 bif:contains \"'%4*'\" . ")
+        .arg(QLatin1String(subject)).arg(object + 1).arg(object).arg(QLatin1String(text));
+}
+
+static QString comparisonPattern(const QUrl &property, const char *op, const Soprano::LiteralValue &value)
+{
+    return QString::fromLatin1("?r %1 ?v1 . FILTER(?v1%2%3) . ")
+        .arg(Soprano::Node::resourceToN3(property)).arg(QLatin1String(op)).arg(Soprano::Node::literalToN3(value));
+}
+
+static Token comparisonToken(qint64 value, const QUrl &property, Nepomuk2::Query::ComparisonTerm::Comparator comparator)
+{
+    Token token = Token::fromInteger(value);
+
+    token.comparison = true;
+    token.comparator = comparator;
+    token.property = property;
+
+    return token;
+}
+
+static int checkSparqlCase(QTextStream &out,
+                           const SparqlEmitter &emitter,
+                           const Calendar &calendar,
+                           const FuseKeywords &keywords,
+                           const char *name,
+                           const QVector<Token> &tokens,
+                           const QString &expected_pattern)
+{
+    QString sparql = emitter.toSparql(tokens, calendar, keywords);
+    QString expected = QLatin1String("select distinct ?r where { ") + expected_pattern + QLatin1String("}");
+
+    if (sparql == expected) {
+        return 0;
+    }
+
+    out << "wrong SPARQL: " << name << "\n"
+        << "    written:  " << sparql << "\n"
+        << "    expected: " << expected << "\n";
+
+    return 1;
+}
+
+int checkSparqlText()
+{
+    QTextStream out(stdout);
+    QUrl property = Nepomuk2::Vocabulary::NFO::fileSize();
+    SparqlEmitter emitter(QList<QUrl>() << property);
+    Calendar calendar;
+    FuseKeywords keywords;
+    int failures = 0;
+
+    QString alpha = containsPattern("?r", 1, "alpha");
+    QString beta = containsPattern("?r", 3, "beta");
+    QString gamma = containsPattern("?r", 5, "gamma");
+
+    // Grouping of the terms
+    failures += checkSparqlCase(out, emitter, calendar, keywords, "AND",
+        stringTokens("alpha beta"), alpha + beta);
+    failures += checkSparqlCase(out, emitter, calendar, keywords, "explicit AND",
+        stringTokens("alpha and beta"), alpha + beta);
+    failures += checkSparqlCase(out, emitter, calendar, keywords, "OR",
+        stringTokens("alpha or beta"),
+        QLatin1String("{ ") + alpha + QLatin1String("} UNION { ") + beta + QLatin1String("} "));
+    failures += checkSparqlCase(out, emitter, calendar, keywords, "chained OR",
+        stringTokens("alpha or beta or gamma"),
+        QLatin1String("{ ") + alpha + QLatin1String("} UNION { ") + beta +
+        QLatin1String("} UNION { ") + gamma + QLatin1String("} "));
+    failures += checkSparqlCase(out, emitter, calendar, keywords, "NOT",
+        stringTokens("alpha not beta"),
+        alpha + QLatin1String("FILTER(!bif:exists((select (1 as ?dummy) where { ") + beta + QLatin1String("}))) . "));
+    failures += checkSparqlCase(out, emitter, calendar, keywords, "NOT first",
+        stringTokens("not alpha"),
+        QLatin1String("?r a ?v3 . FILTER(!bif:exists((select (1 as ?dummy) where { ") + alpha + QLatin1String("}))) . "));
+    failures += checkSparqlCase(out, emitter, calendar, keywords, "OR NOT",
+        stringTokens("alpha or not beta"),
+        QLatin1String("{ ") + alpha + QLatin1String("} UNION { ?r a ?v5 . FILTER(!bif:exists((select (1 as ?dummy) where { ") +
+        beta + QLatin1String("}))) . } "));
+    failures += checkSparqlCase(out, emitter, calendar, keywords, "parentheses",
+        stringTokens("alpha or ( beta gamma )"),
+        QLatin1String("{ ") + alpha + QLatin1String("} UNION { ") + beta + gamma + QLatin1String("} "));
+    failures += checkSparqlCase(out, emitter, calendar, keywords, "empty parentheses",
+        stringTokens("alpha ( )"), alpha);
+
+    // Parentheses nested deeper than FuseKeywords::MaxDepth are ignored
+    QVector<Token> nested;
+
+    for (int i=0; i<1000; ++i) {
+        nested.append(Token::fromString(QLatin1String("(")));
+    }
+
+    nested.append(Token::fromString(QLatin1String("alpha")));
+
+    for (int i=0; i<1000; ++i) {
+        nested.append(Token::fromString(QLatin1String(")")));
+    }
+
+    failures += checkSparqlCase(out, emitter, calendar, keywords, "deep parentheses", nested, alpha);
+
+    // Subqueries, compared with the property of their token or merged in
+    // the query
+    Token subquery = Token::fromSubquery(stringTokens("alpha"));
+
+    failures += checkSparqlCase(out, emitter, calendar, keywords, "subquery",
+        singleToken(subquery), alpha);
+
+    subquery.comparison = true;
+    subquery.property = property;
+
+    failures += checkSparqlCase(out, emitter, calendar, keywords, "compared subquery",
+        singleToken(subquery),
+        QLatin1String("?r ") + Soprano::Node::resourceToN3(property) + QLatin1String(" ?v1 . ") +
+        containsPattern("?v1", 2, "alpha"));
+
+    // Comparators
+    Soprano::LiteralValue five(qlonglong(5));
+
+    failures += checkSparqlCase(out, emitter, calendar, keywords, "equal",
+        singleToken(comparisonToken(5, property, Nepomuk2::Query::ComparisonTerm::Equal)),
+        comparisonPattern(property, "=", five));
+    failures += checkSparqlCase(out, emitter, calendar, keywords, "greater",
+        singleToken(comparisonToken(5, property, Nepomuk2::Query::ComparisonTerm::Greater)),
+        comparisonPattern(property, ">", five));
+    failures += checkSparqlCase(out, emitter, calendar, keywords, "smaller",
+        singleToken(comparisonToken(5, property, Nepomuk2::Query::ComparisonTerm::Smaller)),
+        comparisonPattern(property, "<", five));
+    failures += checkSparqlCase(out, emitter, calendar, keywords, "greater or equal",
+        singleToken(comparisonToken(5, property, Nepomuk2::Query::ComparisonTerm::GreaterOrEqual)),
+        comparisonPattern(property, ">=", five));
+    failures += checkSparqlCase(out, emitter, calendar, keywords, "smaller or equal",
+        singleToken(comparisonToken(5, property, Nepomuk2::Query::ComparisonTerm::SmallerOrEqual)),
+        comparisonPattern(property, "<=", five));
+
+    out << "wrong queries: " << failures << "\n";
+
+    return (failures == 0 ? 0 : 1);
+}
+
+/*
+ * SPARQL written by the parser, it must select the same resources as the
+ * query built by Nepomuk2::Query::Query::toSparqlQuery()
+ */
+static void selectResources(Soprano::Model *model, const QString &sparql, QSet<QUrl> &resources)
+{
+    if (sparql.isEmpty()) {
+        return;
+    }
+
+    Soprano::QueryResultIterator it = model->executeQuery(sparql, Soprano::Query::QueryLanguageSparql);
+
+    while (it.next()) {
+        resources.insert(it.binding(QLatin1String("r")).uri());
+    }
+
+    it.close();
+}
+
+int checkSparql(const QString &corpus_path)
+{
+    QTextStream out(stdout);
+    QStringList queries;
+
+    if (!readCorpus(corpus_path, out, queries)) {
+        return 1;
+    }
+
+    Soprano::Model *model = Nepomuk2::ResourceManager::instance()->mainModel();
+
+    if (!model) {
+        out << "the Nepomuk storage is not running\n";
+        return 1;
+    }
+
+    Parser parser;
+
+    // Same reference time for both queries
+    QDateTime reference_time(QDate(2013, 6, 13), QTime(12, 0));
+    int mismatches = 0;
+
+    Q_FOREACH(const QString &query, queries) {
+        QSet<QUrl> expected;
+        QSet<QUrl> resources;
+
+        selectResources(model, parser.parse(query, reference_time).toSparqlQuery(), expected);
+        selectResources(model, parser.parseSparql(query, reference_time), resources);
+
+        if (resources != expected) {
+            out << "different resources: " << query << " (" << resources.count()
+                << " instead of " << expected.count() << ")\n";
+            ++mismatches;
+        }
+    }
+
+    out << "queries: " << queries.count() << "\n";
+    out << "different results: " << mismatches << "\n";
+
+    return (mismatches == 0 ? 0 : 1);
+}
@@ -0,0 +1,40 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+
+#include <QString>
+
+/**
+ * Synthetic benchmarks, run with "parser --benchmark-<name>", and checks of
+ * the parser, run with "parser --check-<name>" ("make check" runs the ones
+ * that need no Nepomuk storage). They print their measurements on the
+ * standard output and return the exit code of the program.
+ */
+int benchmarkTags(int tag_count);
+int benchmarkTyping(const QString &query);
+int benchmarkPasses(int iterations);
+int checkBuiltinRules(const QString &corpus_path);
+int checkMatchingModes(const QString &corpus_path);
+int checkIntervals();
+int checkSparqlText();
+int checkSparql(const QString &corpus_path);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,14 @@
+######################################################################
+# "parser --benchmark-passes" also counting the heap allocations
+######################################################################
+
+TEMPLATE = app
+TARGET = parser-benchmark
+
+include(../parser.pri)
+
+DEFINES += COUNT_ALLOCATIONS
+
+HEADERS += ../allocationcounter.h
+SOURCES += ../main.cpp \
+           ../allocationcounter.cpp
@@ -0,0 +1,91 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __BUILTINRULES_H__
+#define __BUILTINRULES_H__
+
+#include "patternautomaton.h"
+
+/**
+ * Vocabularies and rules of the untranslated locale, compiled into the
+ * program.
+ *
+ * builtinrules.cpp is generated during the build by "parser-rulegen
+ * --generate-rules" (see rulesource.h), that translates and compiles the
+ * rules once. The parsers built for the locale of the tables use them in
+ * place: the automata are not built again and nothing is decoded.
+ */
+
+// Word of a vocabulary and its value, the words are UTF-8 and normalized
+struct BuiltinWord {
+    const char *word;
+    qint64 value;
+};
+
+struct BuiltinWords {
+    const BuiltinWord *words;
+    int count;
+};
+
+// Rule and configuration of its pass, see CompiledRule in parser.cpp
+struct BuiltinRule {
+    int pass;
+    const char *name;
+    int period;
+    int value_type;
+    int value;
+    bool pm;
+    int comparator;
+    const char *property;           // Encoded URL
+    int range;
+    const PatternAutomaton::Tables *automaton;
+};
+
+struct BuiltinStage {
+    const BuiltinRule *rules;
+    int rule_count;
+
+    // Patterns of all the rules, and the rule owning each of them
+    const PatternAutomaton::Tables *automaton;
+    const int *pattern_rules;
+};
+
+struct BuiltinRules {
+    enum {
+        StageCount = 6
+    };
+
+    const char *locale_key;
+    const char *separators;
+
+    BuiltinWords split_units;
+    BuiltinWords number_names;
+    BuiltinWords file_size_units;
+    BuiltinWords type_hints;        // Values are indexes in type_urls
+    const char *const *type_urls;
+    BuiltinWords date_periods;
+    BuiltinWords day_names;
+    BuiltinWords month_names;
+
+    BuiltinStage stages[StageCount];
+};
+
+extern const BuiltinRules builtin_rules;
+
+#endif
\ No newline at end of file
@@ -0,0 +1,313 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "calendar.h"
+
+#include <kglobal.h>
+#include <kcalendarsystem.h>
+
+// Range of Julian days handled without the calendar system
+static const int first_fast_day = 2299161;      // 1582-10-15, first Gregorian day
+static const int last_fast_day = 5373484;       // 9999-12-31
+
+static const int first_fast_year = 1583;
+static const int last_fast_year = 9999;
+
+/*
+ * Conversions between proleptic Gregorian dates and Julian days, from
+ * "chrono-Compatible Low-Level Date Algorithms" (H. Hinnant)
+ */
+static int julianDay(int year, int month, int day)
+{
+    year -= (month <= 2);
+
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int year_of_era = year - era * 400;
+    int day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+
+    return era * 146097 + day_of_era + 1721120;
+}
+
+static void civilDate(int julian_day, int &year, int &month, int &day)
+{
+    int days = julian_day - 1721120;
+    int era = (days >= 0 ? days : days - 146096) / 146097;
+    int day_of_era = days - era * 146097;
+    int year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    int day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    int shifted_month = (5 * day_of_year + 2) / 153;
+
+    day = day_of_year - (153 * shifted_month + 2) / 5 + 1;
+    month = shifted_month + (shifted_month < 10 ? 3 : -9);
+    year = year_of_era + era * 400 + (month <= 2);
+}
+
+static bool isLeapYear(int year)
+{
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+static int daysInMonth(int year, int month)
+{
+    static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+    return (month == 2 && isLeapYear(year)) ? 29 : days[month - 1];
+}
+
+static int isoDayOfWeek(int julian_day)
+{
+    // Julian day 0 is a Monday
+    return julian_day % 7 + 1;
+}
+
+static int isoWeekOfDay(int julian_day, int &iso_year)
+{
+    // The ISO week belongs to the year containing its Thursday
+    int thursday = julian_day - isoDayOfWeek(julian_day) + 4;
+    int month;
+    int day;
+
+    civilDate(thursday, iso_year, month, day);
+
+    return (thursday - julianDay(iso_year, 1, 1)) / 7 + 1;
+}
+
+Calendar::Calendar()
+: system(KGlobal::locale()->calendarSystem()),
+  calendar(KCalendarSystem::create(system))
+{
+    gregorian = (system == KLocale::QDateCalendar || system == KLocale::GregorianCalendar);
+}
+
+Calendar::Calendar(const Calendar &other)
+: system(other.system),
+  calendar(KCalendarSystem::create(other.system)),
+  gregorian(other.gregorian)
+{
+}
+
+Calendar::~Calendar()
+{
+    delete calendar;
+}
+
+bool Calendar::isFast(const QDate &date) const
+{
+    return gregorian &&
+           date.isValid() &&
+           date.toJulianDay() >= first_fast_day &&
+           date.toJulianDay() <= last_fast_day;
+}
+
+bool Calendar::isFast(int year) const
+{
+    return gregorian && year >= first_fast_year && year <= last_fast_year;
+}
+
+int Calendar::year(const QDate &date) const
+{
+    if (!isFast(date)) {
+        return calendar->year(date);
+    }
+
+    int year, month, day;
+
+    civilDate(date.toJulianDay(), year, month, day);
+
+    return year;
+}
+
+int Calendar::month(const QDate &date) const
+{
+    if (!isFast(date)) {
+        return calendar->month(date);
+    }
+
+    int year, month, day;
+
+    civilDate(date.toJulianDay(), year, month, day);
+
+    return month;
+}
+
+int Calendar::day(const QDate &date) const
+{
+    if (!isFast(date)) {
+        return calendar->day(date);
+    }
+
+    int year, month, day;
+
+    civilDate(date.toJulianDay(), year, month, day);
+
+    return day;
+}
+
+int Calendar::dayOfYear(const QDate &date) const
+{
+    if (!isFast(date)) {
+        return calendar->dayOfYear(date);
+    }
+
+    int year, month, day;
+
+    civilDate(date.toJulianDay(), year, month, day);
+
+    return date.toJulianDay() - julianDay(year, 1, 1) + 1;
+}
+
+int Calendar::dayOfWeek(const QDate &date) const
+{
+    if (!isFast(date)) {
+        return calendar->dayOfWeek(date);
+    }
+
+    return isoDayOfWeek(date.toJulianDay());
+}
+
+int Calendar::daysInWeek(const QDate &date) const
+{
+    if (!isFast(date)) {
+        return calendar->daysInWeek(date);
+    }
+
+    return 7;
+}
+
+int Calendar::isoWeek(const QDate &date, int *iso_year) const
+{
+    if (!isFast(date)) {
+        return calendar->week(date, KLocale::IsoWeekNumber, iso_year);
+    }
+
+    int year;
+    int week = isoWeekOfDay(date.toJulianDay(), year);
+
+    if (iso_year) {
+        *iso_year = year;
+    }
+
+    return week;
+}
+
+bool Calendar::setDate(QDate &date, int year, int month, int day) const
+{
+    if (!isFast(year)) {
+        return calendar->setDate(date, year, month, day);
+    }
+
+    // As KCalendarSystem, leave the date unchanged if the values are invalid
+    if (month < 1 || month > 12 || day < 1 || day > daysInMonth(year, month)) {
+        return false;
+    }
+
+    date = QDate::fromJulianDay(julianDay(year, month, day));
+    return true;
+}
+
+bool Calendar::setDate(QDate &date, int year, int day_of_year) const
+{
+    if (!isFast(year)) {
+        return calendar->setDate(date, year, day_of_year);
+    }
+
+    if (day_of_year < 1 || day_of_year > (isLeapYear(year) ? 366 : 365)) {
+        return false;
+    }
+
+    date = QDate::fromJulianDay(julianDay(year, 1, 1) + day_of_year - 1);
+    return true;
+}
+
+bool Calendar::setDateIsoWeek(QDate &date, int year, int week, int day_of_week) const
+{
+    if (!isFast(year)) {
+        return calendar->setDateIsoWeek(date, year, week, day_of_week);
+    }
+
+    // December 28 is always in the last week of its ISO year
+    int weeks_in_year_year;
+    int weeks_in_year = isoWeekOfDay(julianDay(year, 12, 28), weeks_in_year_year);
+
+    if (week < 1 || week > weeks_in_year || day_of_week < 1 || day_of_week > 7) {
+        return false;
+    }
+
+    // January 4 is always in the first week of its ISO year
+    int january4 = julianDay(year, 1, 4);
+    int first_monday = january4 - isoDayOfWeek(january4) + 1;
+
+    date = QDate::fromJulianDay(first_monday + (week - 1) * 7 + day_of_week - 1);
+    return true;
+}
+
+QDate Calendar::addYears(const QDate &date, int years) const
+{
+    if (!isFast(date)) {
+        return calendar->addYears(date, years);
+    }
+
+    int year, month, day;
+
+    civilDate(date.toJulianDay(), year, month, day);
+    year += years;
+
+    if (!isFast(year)) {
+        return calendar->addYears(date, years);
+    }
+
+    // February 29 becomes February 28 in other years
+    return QDate::fromJulianDay(julianDay(year, month, qMin(day, daysInMonth(year, month))));
+}
+
+QDate Calendar::addMonths(const QDate &date, int months) const
+{
+    if (!isFast(date)) {
+        return calendar->addMonths(date, months);
+    }
+
+    int year, month, day;
+
+    civilDate(date.toJulianDay(), year, month, day);
+
+    int total_months = year * 12 + (month - 1) + months;
+
+    year = total_months / 12;
+    month = total_months % 12 + 1;
+
+    if (!isFast(year)) {
+        return calendar->addMonths(date, months);
+    }
+
+    // The day is clamped to the length of the new month (March 31 - 1 month
+    // is February 28 or 29)
+    return QDate::fromJulianDay(julianDay(year, month, qMin(day, daysInMonth(year, month))));
+}
+
+QDate Calendar::addDays(const QDate &date, int days) const
+{
+    if (!isFast(date) ||
+        date.toJulianDay() + days < first_fast_day ||
+        date.toJulianDay() + days > last_fast_day) {
+        return calendar->addDays(date, days);
+    }
+
+    return QDate::fromJulianDay(date.toJulianDay() + days);
+}
@@ -0,0 +1,72 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __CALENDAR_H__
+#define __CALENDAR_H__
+
+#include <klocale.h>
+
+#include <QDate>
+
+class KCalendarSystem;
+
+/**
+ * Date arithmetic in the calendar system of the locale, used to fold
+ * date-times and to build the intervals of date-time comparisons.
+ *
+ * The calendar system is created once. Gregorian dates between the
+ * Gregorian reform and year 9999 are computed with integer arithmetic on
+ * Julian days, the other ones are given to the KCalendarSystem.
+ */
+class Calendar
+{
+    public:
+        Calendar();
+        Calendar(const Calendar &other);
+        ~Calendar();
+
+        int year(const QDate &date) const;
+        int month(const QDate &date) const;
+        int day(const QDate &date) const;
+        int dayOfYear(const QDate &date) const;
+        int dayOfWeek(const QDate &date) const;
+        int daysInWeek(const QDate &date) const;
+        int isoWeek(const QDate &date, int *iso_year) const;
+
+        bool setDate(QDate &date, int year, int month, int day) const;
+        bool setDate(QDate &date, int year, int day_of_year) const;
+        bool setDateIsoWeek(QDate &date, int year, int week, int day_of_week) const;
+
+        QDate addYears(const QDate &date, int years) const;
+        QDate addMonths(const QDate &date, int months) const;
+        QDate addDays(const QDate &date, int days) const;
+
+    private:
+        bool isFast(const QDate &date) const;
+        bool isFast(int year) const;
+
+        Calendar &operator=(const Calendar &other);
+
+    private:
+        KLocale::CalendarSystem system;
+        KCalendarSystem *calendar;
+        bool gregorian;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,239 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "datetimespec.h"
+#include "calendar.h"
+#include "token.h"
+
+typedef DateTimeSpec::Field Field;
+
+static int fieldIsRelative(const Field &field, int if_yes, int if_no)
+{
+    return (field.flags == Field::Relative ? if_yes : if_no);
+}
+
+static int fieldValue(const Field &field, bool in_defined_period, int now_value, int null_value)
+{
+    switch (field.flags)
+    {
+        case Field::Unset:
+            return (in_defined_period ? now_value : null_value);
+        case Field::Absolute:
+            return field.value;
+        case Field::Relative:
+            return now_value;
+    }
+
+    return 0;
+}
+
+static bool fieldUsesNow(const Field &field, bool in_defined_period)
+{
+    return (field.flags == Field::Relative || (field.flags == Field::Unset && in_defined_period));
+}
+
+
+DateTimeSpec::DateTimeSpec()
+{
+    reset();
+}
+
+void DateTimeSpec::reset()
+{
+    for (int i=0; i<int(PassDatePeriods::MaxPeriod); ++i) {
+        fields[i].value = 0;
+        fields[i].flags = Field::Unset;
+    }
+}
+
+void DateTimeSpec::setPeriod(const Token &token)
+{
+    // Populate the field corresponding to the period of the token
+    Field &field = fields[token.period];
+
+    field.value = int(token.integer);
+    field.flags = (token.offset ? Field::Relative : Field::Absolute);
+}
+
+bool DateTimeSpec::operator==(const DateTimeSpec &other) const
+{
+    for (int i=0; i<int(PassDatePeriods::MaxPeriod); ++i) {
+        if (fields[i].flags != other.fields[i].flags || fields[i].value != other.fields[i].value) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+PassDatePeriods::Period DateTimeSpec::lastDefinedDate() const
+{
+    // If no date is given, use the current date-time
+    for (int period=PassDatePeriods::Day; period>=PassDatePeriods::Year; --period) {
+        if (fields[period].flags != Field::Unset) {
+            return PassDatePeriods::Period(period);
+        }
+    }
+
+    return PassDatePeriods::Day;
+}
+
+PassDatePeriods::Period DateTimeSpec::lastDefinedTime() const
+{
+    // If no time is given, use 00:00:00
+    for (int period=PassDatePeriods::Second; period>=PassDatePeriods::Hour; --period) {
+        if (fields[period].flags != Field::Unset) {
+            return PassDatePeriods::Period(period);
+        }
+    }
+
+    return PassDatePeriods::Year;
+}
+
+int DateTimeSpec::nowPeriod() const
+{
+    // Finest period of the reference time used by resolve(), -1 if the
+    // resolved date-time does not depend on it
+    const Field &year = fields[PassDatePeriods::Year];
+    const Field &month = fields[PassDatePeriods::Month];
+    const Field &day = fields[PassDatePeriods::Day];
+    const Field &hour = fields[PassDatePeriods::Hour];
+    const Field &minute = fields[PassDatePeriods::Minute];
+    const Field &second = fields[PassDatePeriods::Second];
+
+    PassDatePeriods::Period last_defined_date = lastDefinedDate();
+    PassDatePeriods::Period last_defined_time = lastDefinedTime();
+    int now_period = -1;
+
+    // The week and day of week are computed from the date, not from now
+    if (fieldUsesNow(year, last_defined_date >= PassDatePeriods::Year) ||
+        (month.flags != Field::Unset ?
+            fieldUsesNow(month, last_defined_date >= PassDatePeriods::Month) ||
+            fieldUsesNow(day, last_defined_date >= PassDatePeriods::Day) :
+            fieldUsesNow(day, last_defined_date >= PassDatePeriods::Week)) ||
+        fields[PassDatePeriods::Week].flags == Field::Relative)
+    {
+        now_period = PassDatePeriods::Day;
+    }
+
+    if (fieldUsesNow(hour, last_defined_time >= PassDatePeriods::Hour)) {
+        now_period = PassDatePeriods::Hour;
+    }
+    if (fieldUsesNow(minute, last_defined_time >= PassDatePeriods::Minute)) {
+        now_period = PassDatePeriods::Minute;
+    }
+    if (fieldUsesNow(second, last_defined_time >= PassDatePeriods::Second)) {
+        now_period = PassDatePeriods::Second;
+    }
+
+    return now_period;
+}
+
+QDateTime DateTimeSpec::resolve(const Calendar &calendar, const QDateTime &now) const
+{
+    QDate cdate = now.date();
+    QTime ctime = now.time();
+
+    const Field &year = fields[PassDatePeriods::Year];
+    const Field &month = fields[PassDatePeriods::Month];
+    const Field &week = fields[PassDatePeriods::Week];
+    const Field &dayofweek = fields[PassDatePeriods::DayOfWeek];
+    const Field &day = fields[PassDatePeriods::Day];
+    const Field &hour = fields[PassDatePeriods::Hour];
+    const Field &minute = fields[PassDatePeriods::Minute];
+    const Field &second = fields[PassDatePeriods::Second];
+
+    PassDatePeriods::Period last_defined_date = lastDefinedDate();
+    PassDatePeriods::Period last_defined_time = lastDefinedTime();
+
+    // Absolute year, month, day of month
+    QDate date;
+
+    if (month.flags != Field::Unset)
+    {
+        // Month set, day of month
+        calendar.setDate(
+            date,
+            fieldValue(year, last_defined_date >= PassDatePeriods::Year, calendar.year(cdate), 1),
+            fieldValue(month, last_defined_date >= PassDatePeriods::Month, calendar.month(cdate), 1),
+            fieldValue(day, last_defined_date >= PassDatePeriods::Day, calendar.day(cdate), 1)
+        );
+    } else {
+        calendar.setDate(
+            date,
+            fieldValue(year, last_defined_date >= PassDatePeriods::Year, calendar.year(cdate), 1),
+            fieldValue(day, last_defined_date >= PassDatePeriods::Week, calendar.dayOfYear(cdate), 1)
+        );
+    }
+
+    // Absolute week and day of week
+    int isoyear;
+    int isoweek = calendar.isoWeek(date, &isoyear);
+    int isoday = calendar.dayOfWeek(date);
+
+    calendar.setDateIsoWeek(
+        date,
+        isoyear,
+        (week.flags == Field::Absolute && month.flags != Field::Unset) ?
+            // Week of month, isoweek is the first week of the month
+            isoweek + (week.value - 1) :
+            // Week of year (or no week at all)
+            fieldValue(week, last_defined_date >= PassDatePeriods::Week, isoweek, isoweek),
+        fieldValue(dayofweek, last_defined_date >= PassDatePeriods::DayOfWeek, isoday, 1)
+    );
+
+    // Relative year, month, week, day of month
+    if (year.flags == Field::Relative) {
+        date = calendar.addYears(date, year.value);
+    }
+    if (month.flags == Field::Relative) {
+        date = calendar.addMonths(date, month.value);
+    }
+    if (week.flags == Field::Relative) {
+        date = calendar.addDays(date, week.value * calendar.daysInWeek(date));
+    }
+    if (day.flags == Field::Relative) {
+        date = calendar.addDays(date, day.value);
+    }
+
+    // Absolute time
+    QTime time = QTime(
+        fieldValue(hour, last_defined_time >= PassDatePeriods::Hour, ctime.hour(), 0),
+        fieldValue(minute, last_defined_time >= PassDatePeriods::Minute, ctime.minute(), 0),
+        fieldValue(second, last_defined_time >= PassDatePeriods::Second, ctime.second(), 0)
+    );
+
+    // Relative time
+    QDateTime rs(date, time);
+
+    rs = rs.addSecs(
+        fieldIsRelative(hour, hour.value * 60 * 60, 0) +
+        fieldIsRelative(minute, minute.value * 60, 0) +
+        fieldIsRelative(second, second.value, 0)
+    );
+
+    // Store the last defined period in the millisecond part of the date-time.
+    // This way, equality comparisons with a date-time can be changed to comparisons
+    // against an interval whose size is defined by the last defined period.
+    rs = rs.addMSecs(
+        qMax(last_defined_date, last_defined_time)
+    );
+
+    return rs;
+}
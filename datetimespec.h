@@ -0,0 +1,72 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __DATETIMESPEC_H__
+#define __DATETIMESPEC_H__
+
+#include "pass_dateperiods.h"
+
+#include <QDateTime>
+
+struct Token;
+class Calendar;
+
+/**
+ * Date-time given by the values or offsets of some of its periods, for
+ * instance "June 6 at 14:30" or "last week".
+ *
+ * The periods that are not given are taken from a reference time, that is
+ * only known when the spec is resolved. This way, a query containing
+ * relative dates can be parsed once and resolved for several reference
+ * times.
+ */
+class DateTimeSpec
+{
+    public:
+        struct Field {
+            enum Flags {
+                Unset = 0,
+                Absolute,
+                Relative
+            };
+
+            int value;
+            Flags flags;
+        };
+
+    public:
+        DateTimeSpec();
+
+        void reset();
+        void setPeriod(const Token &token);
+
+        int nowPeriod() const;
+        QDateTime resolve(const Calendar &calendar, const QDateTime &now) const;
+
+        bool operator==(const DateTimeSpec &other) const;
+
+    private:
+        PassDatePeriods::Period lastDefinedDate() const;
+        PassDatePeriods::Period lastDefinedTime() const;
+
+    private:
+        Field fields[PassDatePeriods::MaxPeriod];
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,94 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "incrementalscan.h"
+
+IncrementalScan::IncrementalScan()
+: checkpoint_index(-1),
+  checkpoint_horizon(-1),
+  limit(0),
+  horizon(-1)
+{
+}
+
+int IncrementalScan::resume(QVector<Token> &tokens)
+{
+    // First input token that changed since the last walk
+    int common = 0;
+    int count = qMin(input.count(), tokens.count());
+
+    while (common < count && input.at(common) == tokens.at(common)) {
+        ++common;
+    }
+
+    // Start of the text covered by the old tokens that are not kept
+    int changed_position = 1 << 30;
+
+    for (int i=common; i<input.count(); ++i) {
+        changed_position = qMin(changed_position, input.at(i).position);
+    }
+
+    int kept = checkpoint_tokens.count() - (input.count() - common);
+    int first_index = 0;
+
+    input = tokens;
+    limit = (tokens.count() > 0 ? tokens.last().position : 0);
+    horizon = -1;
+
+    if (checkpoint_index != -1 && checkpoint_horizon < changed_position && checkpoint_index <= kept) {
+        // The walk until the checkpoint only read tokens that did not change.
+        // The tokens after it are still the input tokens, that are replaced
+        // with the new ones.
+        QVector<Token> resumed = checkpoint_tokens;
+
+        resumed.resize(kept);
+        resumed += tokens.mid(common);
+
+        tokens = resumed;
+        first_index = checkpoint_index;
+        horizon = checkpoint_horizon;
+    }
+
+    checkpoint_index = -1;
+
+    return first_index;
+}
+
+void IncrementalScan::beforeMatch(const QVector<Token> &tokens, int index, int match_horizon)
+{
+    if (checkpoint_index == -1 && match_horizon >= limit) {
+        setCheckpoint(tokens, index);
+    }
+
+    horizon = qMax(horizon, match_horizon);
+}
+
+void IncrementalScan::finish(const QVector<Token> &tokens)
+{
+    if (checkpoint_index == -1) {
+        setCheckpoint(tokens, tokens.count());
+    }
+}
+
+void IncrementalScan::setCheckpoint(const QVector<Token> &tokens, int index)
+{
+    checkpoint_tokens = tokens;
+    checkpoint_index = index;
+    checkpoint_horizon = horizon;
+}
@@ -0,0 +1,58 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __INCREMENTALSCAN_H__
+#define __INCREMENTALSCAN_H__
+
+#include "token.h"
+#include <QVector>
+
+/**
+ * Left-to-right walk of a matcher over its tokens, remembered between the
+ * parses of a ParseSession.
+ *
+ * A checkpoint is recorded just before the matcher first reads the last token
+ * of its input. It contains the tokens at that time and the end of the text
+ * read until then. When only the tokens after that text change, the next walk
+ * resumes from the checkpoint instead of starting over.
+ */
+class IncrementalScan
+{
+    public:
+        IncrementalScan();
+
+        int resume(QVector<Token> &tokens);
+        void beforeMatch(const QVector<Token> &tokens, int index, int horizon);
+        void finish(const QVector<Token> &tokens);
+
+    private:
+        void setCheckpoint(const QVector<Token> &tokens, int index);
+
+    private:
+        QVector<Token> input;               // Tokens given to the last walk
+        QVector<Token> checkpoint_tokens;
+        int checkpoint_index;               // -1 if there is no checkpoint
+        int checkpoint_horizon;
+
+        // State of the current walk
+        int limit;                          // Position of the last input token
+        int horizon;                        // End of the text read until now
+};
+
+#endif
\ No newline at end of file
@@ -18,17 +18,101 @@
 */
 
 #include "parser.h"
+#include "benchmark.h"
+#include "server.h"
 
 #include <QCoreApplication>
 #include <QtDebug>
 
+#include <stdlib.h>
+
 int main(int argc, char **argv)
 {
+    // Rules translated and compiled by "parser --save-rules <path>"
+    QString rule_table;
+
+    if (argc >= 3 && qstrcmp(argv[1], "--rules") == 0) {
+        rule_table = QString::fromLocal8Bit(argv[2]);
+
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    if (argc >= 2 && qstrcmp(argv[1], "--benchmark-tags") == 0)
+        return benchmarkTags(argc >= 3 ? atoi(argv[2]) : 1000000);
+
+    if (argc >= 3 && qstrcmp(argv[1], "--benchmark-typing") == 0) {
+        QCoreApplication app(argc, argv);
+
+        return benchmarkTyping(QString::fromLocal8Bit(argv[2]));
+    }
+
+    if (argc >= 2 && qstrcmp(argv[1], "--benchmark-passes") == 0) {
+        QCoreApplication app(argc, argv);
+
+        return benchmarkPasses(argc >= 3 ? atoi(argv[2]) : 10000);
+    }
+
+    if (argc >= 3 && qstrcmp(argv[1], "--save-rules") == 0) {
+        QCoreApplication app(argc, argv);
+        Parser parser;
+
+        return parser.saveRuleTable(QString::fromLocal8Bit(argv[2])) ? 0 : 1;
+    }
+
+    if (argc >= 3 && qstrcmp(argv[1], "--generate-rules") == 0) {
+        QCoreApplication app(argc, argv);
+        Parser parser(Parser::TranslatedRules);
+
+        return parser.saveRuleSource(QString::fromLocal8Bit(argv[2])) ? 0 : 1;
+    }
+
+    if (argc >= 2 && qstrcmp(argv[1], "--check-builtin-rules") == 0) {
+        QCoreApplication app(argc, argv);
+
+        return checkBuiltinRules(argc >= 3 ? QString::fromLocal8Bit(argv[2]) : QString());
+    }
+
+    if (argc >= 2 && qstrcmp(argv[1], "--check-matching-modes") == 0) {
+        QCoreApplication app(argc, argv);
+
+        return checkMatchingModes(argc >= 3 ? QString::fromLocal8Bit(argv[2]) : QString());
+    }
+
+    if (argc >= 2 && qstrcmp(argv[1], "--check-intervals") == 0) {
+        QCoreApplication app(argc, argv);
+
+        return checkIntervals();
+    }
+
+    if (argc >= 2 && qstrcmp(argv[1], "--check-sparql-text") == 0) {
+        QCoreApplication app(argc, argv);
+
+        return checkSparqlText();
+    }
+
+    if (argc >= 2 && qstrcmp(argv[1], "--check-sparql") == 0) {
+        QCoreApplication app(argc, argv);
+
+        return checkSparql(argc >= 3 ? QString::fromLocal8Bit(argv[2]) : QString());
+    }
+
+    if (argc >= 2 && qstrcmp(argv[1], "--server") == 0) {
+        QCoreApplication app(argc, argv);
+        Parser parser(rule_table);
+
+        // The same queries are often sent again by the clients
+        parser.setCacheSize(4096);
+
+        return runServer(parser, argc >= 3 ? QString::fromLocal8Bit(argv[2]) : QString());
+    }
+
     if (argc != 2)
         return 0;
 
     QCoreApplication app(argc, argv);
-    Parser parser;
+    Parser parser(rule_table);
 
     qDebug() << parser.parse(argv[1]);
 
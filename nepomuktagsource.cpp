@@ -0,0 +1,101 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "nepomuktagsource.h"
+
+#include <nepomuk2/resource.h>
+#include <nepomuk2/resourcemanager.h>
+#include <nepomuk2/resourcewatcher.h>
+#include <nepomuk2/class.h>
+#include <nepomuk2/property.h>
+#include <soprano/nao.h>
+#include <soprano/rdfs.h>
+#include <soprano/model.h>
+#include <soprano/queryresultiterator.h>
+
+NepomukTagSource::NepomukTagSource(QObject *parent)
+: QObject(parent)
+{
+    // Watch the labels of the tags
+    watcher = new Nepomuk2::ResourceWatcher(this);
+    watcher->addType(Nepomuk2::Types::Class(Soprano::Vocabulary::NAO::Tag()));
+    watcher->addProperty(Nepomuk2::Types::Property(Soprano::Vocabulary::RDFS::label()));
+
+    connect(watcher, SIGNAL(resourceRemoved(QUrl,QList<QUrl>)),
+            this, SLOT(resourceRemoved(QUrl,QList<QUrl>)));
+    connect(watcher, SIGNAL(propertyChanged(Nepomuk2::Resource,Nepomuk2::Types::Property,QVariantList,QVariantList)),
+            this, SLOT(propertyChanged(Nepomuk2::Resource,Nepomuk2::Types::Property,QVariantList,QVariantList)));
+
+    watcher->start();
+}
+
+QHash<QUrl, QString> NepomukTagSource::loadTags()
+{
+    QHash<QUrl, QString> tags;
+
+    // Get the tags URIs and their label in one SPARQL query
+    QString query = QString::fromLatin1("select ?tag ?label where { "
+                                        "?tag a %1 . "
+                                        "?tag %2 ?label . "
+                                        "}")
+                    .arg(Soprano::Node::resourceToN3(Soprano::Vocabulary::NAO::Tag()),
+                         Soprano::Node::resourceToN3(Soprano::Vocabulary::RDFS::label()));
+
+    Soprano::QueryResultIterator it =
+        Nepomuk2::ResourceManager::instance()->mainModel()->executeQuery(query, Soprano::Query::QueryLanguageSparql);
+
+    while(it.next()) {
+        tags.insert(
+            QUrl(it["tag"].toString()),
+            it["label"].toString()
+        );
+    }
+
+    return tags;
+}
+
+void NepomukTagSource::resourceRemoved(const QUrl &uri, const QList<QUrl> &types)
+{
+    Q_UNUSED(types);
+
+    notifyRemoved(uri);
+}
+
+void NepomukTagSource::propertyChanged(const Nepomuk2::Resource &resource,
+                                       const Nepomuk2::Types::Property &property,
+                                       const QVariantList &added_values,
+                                       const QVariantList &removed_values)
+{
+    if (property.uri() != Soprano::Vocabulary::RDFS::label()) {
+        return;
+    }
+
+    if (!added_values.isEmpty()) {
+        QString label = added_values.first().toString();
+
+        if (removed_values.isEmpty()) {
+            notifyAdded(resource.uri(), label);
+        } else {
+            notifyRenamed(resource.uri(), label);
+        }
+    } else if (!removed_values.isEmpty()) {
+        // A tag without label cannot be found by the parser
+        notifyRemoved(resource.uri());
+    }
+}
@@ -0,0 +1,59 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __NEPOMUKTAGSOURCE_H__
+#define __NEPOMUKTAGSOURCE_H__
+
+#include "tagsource.h"
+
+#include <QObject>
+#include <QList>
+#include <QVariant>
+
+namespace Nepomuk2 {
+    class Resource;
+    class ResourceWatcher;
+    namespace Types { class Property; }
+}
+
+/**
+ * Tags stored in the Nepomuk model. The tags are loaded with one SPARQL query,
+ * then kept up to date by watching the tag resources and their labels.
+ */
+class NepomukTagSource : public QObject, public TagSource
+{
+    Q_OBJECT
+
+    public:
+        explicit NepomukTagSource(QObject *parent = 0);
+
+        virtual QHash<QUrl, QString> loadTags();
+
+    private slots:
+        void resourceRemoved(const QUrl &uri, const QList<QUrl> &types);
+        void propertyChanged(const Nepomuk2::Resource &resource,
+                             const Nepomuk2::Types::Property &property,
+                             const QVariantList &added_values,
+                             const QVariantList &removed_values);
+
+    private:
+        Nepomuk2::ResourceWatcher *watcher;
+};
+
+#endif
\ No newline at end of file
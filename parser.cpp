@@ -19,7 +19,20 @@
 
 #include "parser.h"
 #include "patternmatcher.h"
+#include "patternautomaton.h"
+#include "stagematcher.h"
+#include "rule.h"
+#include "tokenizer.h"
+#include "querycache.h"
+#include "incrementalscan.h"
+#include "calendar.h"
+#include "datetimespec.h"
 #include "utils.h"
+#include "statistics.h"
+#include "ruletable.h"
+#include "builtinrules.h"
+#include "rulesource.h"
+#include "sparqlemitter.h"
 
 #include "pass_splitunits.h"
 #include "pass_numbers.h"
@@ -32,68 +45,415 @@
 #include "pass_subqueries.h"
 #include "pass_comparators.h"
 
-#include <nepomuk2/literalterm.h>
 #include <nepomuk2/property.h>
 #include <nepomuk2/nfo.h>
 #include <nepomuk2/nmo.h>
 #include <nepomuk2/nie.h>
-#include <soprano/literalvalue.h>
 #include <soprano/nao.h>
 
-#include <klocale.h>
-#include <kcalendarsystem.h>
 #include <klocalizedstring.h>
 
 #include <QList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QDataStream>
 #include <QtDebug>
 
-struct Field {
-    enum Flags {
-        Unset = 0,
-        Absolute,
-        Relative
+struct CompiledRule {
+    enum PassKind {
+        SplitUnits,
+        Numbers,
+        FileSize,
+        TypeHints,
+        PeriodNames,
+        DatePeriods,
+        DateValues,
+        Comparators,
+        Properties,
+        Subqueries
     };
 
+    CompiledRule(PassKind pass = SplitUnits)
+    : pass(pass),
+      index(-1),
+      period(PassDatePeriods::VariablePeriod),
+      value_type(PassDatePeriods::Value),
+      value(0),
+      pm(false),
+      comparator(Nepomuk2::Query::ComparisonTerm::Equal),
+      range(PassProperties::String)
+    {}
+
+    PassKind pass;
+    Rule rule;
+    QString name;   // Context of the translation of the rule
+    int index;      // Index of the rule in the statistics of the parser
+
+    // Configuration of the pass when it runs this rule
+    PassDatePeriods::Period period;
+    PassDatePeriods::ValueType value_type;
     int value;
-    Flags flags;
+    bool pm;
+    Nepomuk2::Query::ComparisonTerm::Comparator comparator;
+    QUrl property;
+    PassProperties::Types range;
+};
+
+struct Stage {
+    QList<CompiledRule> rules;
+
+    // Patterns of all the rules, and the rule owning each of them
+    PatternAutomaton automaton;
+    QList<int> pattern_rules;
+};
+
+// State of a single call to Parser::parse(), so that one parser can be used
+// by many threads at the same time
+struct ParseContext {
+    ParseContext()
+    : now_period(-1),
+      scans(0),
+      statistics(0),
+      words_valid(false)
+    {}
+
+    // Walk of the next matcher when parsing for a ParseSession, 0 otherwise
+    IncrementalScan *nextScan()
+    {
+        return scans ? scans++ : 0;
+    }
+
+    // Normalized words of the literal tokens, keys of the anchors of the rules
+    const QSet<QString> &words()
+    {
+        if (!words_valid) {
+            word_set.clear();
+
+            Q_FOREACH(const Token &token, tokens) {
+                if (token.isLiteral()) {
+                    word_set.insert(token.toKey());
+                }
+            }
+
+            words_valid = true;
+        }
 
-    void reset()
+        return word_set;
+    }
+
+    void tokensChanged()
     {
-        value = 0;
-        flags = Unset;
+        words_valid = false;
     }
+
+    QVector<Token> tokens;
+
+    // Finest period of the reference time used by the relative date-times
+    // of the query, -1 if the query does not depend on it
+    int now_period;
+
+    // Walks of the matchers of a ParseSession, one per rule
+    IncrementalScan *scans;
+
+    // Counters of the current thread, 0 if the statistics are disabled
+    StatisticsCollector::Shard *statistics;
+
+    QSet<QString> word_set;
+    bool words_valid;
 };
 
-struct DateTimeSpec {
-    Field fields[PassDatePeriods::MaxPeriod];
+// Measures a step of a parse, if the statistics are enabled
+struct StepTimer {
+    StepTimer(StatisticsCollector::Shard *statistics, int step)
+    : statistics(statistics), step(step)
+    {
+        if (statistics) {
+            timer.start();
+        }
+    }
 
-    void reset()
+    ~StepTimer()
     {
-        for (int i=0; i<int(PassDatePeriods::MaxPeriod); ++i) {
-            fields[i].reset();
+        if (statistics) {
+            statistics->addLatency(step, timer.nsecsElapsed());
         }
     }
+
+    StatisticsCollector::Shard *statistics;
+    int step;
+    QElapsedTimer timer;
 };
 
+// Queries of a batch, shared by all the workers parsing it
+struct BatchJob {
+    BatchJob(const QStringList &queries, QVector<Nepomuk2::Query::Query> &results)
+    : queries(queries),
+      results(results.data()),
+      next_query(0)
+    {}
+
+    const QStringList &queries;
+    Nepomuk2::Query::Query *results;    // One slot per query, written by one worker
+    QAtomicInt next_query;
+};
+
+// Parses chunks of a batch, the parser is shared by all the workers
+struct BatchWorker : public QRunnable {
+    enum {
+        ChunkSize = 64
+    };
+
+    BatchWorker(const Parser &parser, BatchJob &job)
+    : parser(parser), job(job)
+    {}
+
+    void run()
+    {
+        int count = job.queries.count();
+
+        while (true) {
+            int first = job.next_query.fetchAndAddRelaxed(ChunkSize);
+
+            if (first >= count) {
+                break;
+            }
+
+            for (int i=first; i<qMin(first + int(ChunkSize), count); ++i) {
+                job.results[i] = parser.parse(job.queries.at(i));
+            }
+        }
+    }
+
+    const Parser &parser;
+    BatchJob &job;
+};
+
+static Nepomuk2::Query::Query buildQuery(QVector<Token> tokens,
+                                         const Calendar &calendar,
+                                         const FuseKeywords &keywords,
+                                         const QDateTime &reference_time)
+{
+    // Resolve the relative date-times, then fuse the tokens into a big AND
+    // term and produce the query
+    int end_index;
+
+    resolveDateTimes(tokens, calendar, reference_time);
+
+    return Nepomuk2::Query::Query(fuseTerms(tokens, 0, end_index, calendar, keywords));
+}
+
+static void appendWords(QVector<Token> &tokens, const QString &text, const QVector<Tokenizer::Span> &spans)
+{
+    tokens.reserve(tokens.count() + spans.count());
+
+    Q_FOREACH(const Tokenizer::Span &span, spans) {
+        Token token = Token::fromString(Tokenizer::spanText(text, span));
+        token.setPosition(span.position, token.string.size());
+
+        tokens.append(token);
+    }
+}
+
 struct Parser::Private
 {
+    enum StageId {
+        LiteralValuesStage,
+        DatePeriodsStage,
+        DateValuesStage,
+        ComparatorsStage,
+        PropertiesStage,
+        SubqueriesStage,
+        StageCount
+    };
+
+    // Steps of a parse whose duration is measured, the stages come first
+    enum StepId {
+        TokenizeStep = StageCount,
+        FoldDateTimesStep,
+        BuildQueryStep,
+        StepCount
+    };
+
+    // Runs the pass of a single rule, for PatternMatcher
+    struct RuleRunner {
+        RuleRunner(const Private *d, const CompiledRule &rule, ParseContext &context)
+        : d(d), rule(rule), context(context)
+        {}
+
+        QVector<Token> run(const QVector<Token> &match) const
+        {
+            return d->runCountedRule(rule, match, context);
+        }
+
+        const Private *d;
+        const CompiledRule &rule;
+        ParseContext &context;
+    };
+
+    // Runs the pass of a rule of a stage for its patterns, for StageMatcher
+    struct StageRunner {
+        StageRunner(const Private *d, const Stage &stage, int rule, ParseContext &context)
+        : d(d), stage(stage), rule(rule), context(context)
+        {}
+
+        QVector<Token> run(int pattern, const QVector<Token> &match) const
+        {
+            // The patterns of the other rules are matched when they run
+            if (stage.pattern_rules.at(pattern) != rule) {
+                return QVector<Token>();
+            }
+
+            return d->runCountedRule(stage.rules.at(rule), match, context);
+        }
+
+        const Private *d;
+        const Stage &stage;
+        int rule;
+        ParseContext &context;
+    };
+
     Private()
-    : separators(i18nc(
+    : tokenizer(i18nc(
         "Characters that are kept in the query for further processing but are considered word boundaries",
-        ",;:!?()[]{}<>=#+-"))
-    {}
+        ",;:!?()[]{}<>=#+-")),
+      calendar(new Calendar),
+      keywords(new FuseKeywords),
+      matching_mode(Parser::SequentialMatching),
+      worker_count(0)
+    {
+        setupStatistics();
+        compileRules();
+        setupSparqlEmitter();
+    }
 
-    QStringList split(const QString &query, bool split_separators, QList<int> *positions = NULL);
+    // Passes and tokenizer of a rule table, read in declaration order. The
+    // rules are read by loadRules().
+    Private(QDataStream &stream)
+    : pass_splitunits(stream),
+      pass_numbers(stream),
+      pass_filesize(stream),
+      pass_typehints(stream),
+      pass_dateperiods(stream),
+      pass_periodnames(stream),
+      tokenizer(readString(stream)),
+      calendar(new Calendar),
+      keywords(new FuseKeywords),
+      matching_mode(Parser::SequentialMatching),
+      worker_count(0)
+    {
+        setupStatistics();
+    }
 
-    template<typename T>
-    void runPass(const T &pass, const QString &pattern);
-    void foldDateTimes();
-    void handleDateTimeComparison(DateTimeSpec &spec, const Nepomuk2::Query::ComparisonTerm &term);
+    // Vocabularies and rules compiled into the program, used in place
+    Private(const BuiltinRules &rules)
+    : pass_splitunits(rules.split_units),
+      pass_numbers(rules.number_names),
+      pass_filesize(rules.file_size_units),
+      pass_typehints(rules.type_hints, rules.type_urls),
+      pass_dateperiods(rules.date_periods),
+      pass_periodnames(rules.day_names, rules.month_names),
+      tokenizer(QString::fromUtf8(rules.separators)),
+      calendar(new Calendar),
+      keywords(new FuseKeywords),
+      matching_mode(Parser::SequentialMatching),
+      worker_count(0)
+    {
+        setupStatistics();
+        loadBuiltinRules(rules);
+        setupSparqlEmitter();
+    }
+
+    static Private *fromTable(RuleTable &table);
+    static Private *withRules(Parser::RuleSource source);
+
+    static QString readString(QDataStream &stream)
+    {
+        QString rs;
 
-    // Terms on which the parser works
-    QList<Nepomuk2::Query::Term> terms;
+        stream >> rs;
 
-    // Parsing passes (they cache translations, queries, etc)
+        return rs;
+    }
+
+    void setupSparqlEmitter()
+    {
+        // The N3 forms of the properties of the rules are built only once
+        QList<QUrl> properties;
+
+        for (int s=0; s<StageCount; ++s) {
+            Q_FOREACH(const CompiledRule &rule, stages[s].rules) {
+                properties.append(rule.property);
+            }
+        }
+
+        sparql_emitter = QSharedPointer<const SparqlEmitter>(new SparqlEmitter(properties));
+    }
+
+    void setupStatistics()
+    {
+        static const char *step_names[StepCount] = {
+            "literal_values", "date_periods", "date_values", "comparators",
+            "properties", "subqueries", "tokenize", "fold_date_times", "build_query"
+        };
+        QStringList steps;
+
+        for (int i=0; i<StepCount; ++i) {
+            steps.append(QLatin1String(step_names[i]));
+        }
+
+        statistics.setSteps(steps);
+    }
+
+    Rule compileRule(const QString &pattern, const QVector<quint32> &capture_types);
+    void compileRules();
+    CompiledRule &addRule(StageId stage, const CompiledRule &config, const char *name, const QString &pattern);
+    CompiledRule &addCompiledRule(StageId stage, const CompiledRule &rule);
+    CompiledRule &registerRule(StageId stage, const CompiledRule &rule);
+    CompiledRule &addTranslatedRule(StageId stage, const CompiledRule &config, const char *context, const char *pattern);
+    void addDatePeriodRule(PassDatePeriods::Period period,
+                           PassDatePeriods::ValueType value_type,
+                           int value,
+                           const char *context,
+                           const char *pattern);
+    void addDateValueRule(bool pm, const char *context, const char *pattern);
+    void addComparatorRule(Nepomuk2::Query::ComparisonTerm::Comparator comparator,
+                           const char *context,
+                           const char *pattern);
+    void addPropertyRule(const QUrl &property,
+                         PassProperties::Types range,
+                         const char *context,
+                         const char *pattern);
+
+    QByteArray ruleTableData() const;
+    void saveRules(QDataStream &stream) const;
+    bool loadRules(QDataStream &stream);
+    void loadBuiltinRules(const BuiltinRules &rules);
+    QByteArray ruleSource() const;
+
+    QueryTemplate parseTemplate(const QString &query, StatisticsCollector::Shard *statistics) const;
+    Nepomuk2::Query::Query parseQuery(const QString &query,
+                                      const QDateTime &reference_time,
+                                      QueryTemplate &query_template) const;
+    void runStages(ParseContext &context) const;
+    int scanCount() const;
+    QString cacheKey(const QString &query) const;
+    QVector<Nepomuk2::Query::Query> parseBlock(const Parser *parser, const QStringList &queries) const;
+
+    void runStage(ParseContext &context, StageId stage) const;
+    QVector<Token> runRule(const CompiledRule &rule, const QVector<Token> &match) const;
+    QVector<Token> runCountedRule(const CompiledRule &rule,
+                                  const QVector<Token> &match,
+                                  ParseContext &context) const;
+    void foldDateTimes(ParseContext &context) const;
+
+    // Parsing passes (they cache translations, queries, etc). They are not
+    // changed after the parser is built, the rules give them their settings
     PassSplitUnits pass_splitunits;
     PassNumbers pass_numbers;
     PassFileSize pass_filesize;
@@ -106,14 +466,78 @@ struct Parser::Private
     PassSubqueries pass_subqueries;
 
     // Locale-specific
-    QString separators;
+    Tokenizer tokenizer;
+    QSharedPointer<const Calendar> calendar;   // Shared with the query templates
+    QSharedPointer<const FuseKeywords> keywords;
+    QSharedPointer<const SparqlEmitter> sparql_emitter;    // Also shared with the templates
+
+    // Rules, translated and compiled once when the parser is built
+    Stage stages[StageCount];
+    Parser::MatchingMode matching_mode;
+
+    // Number of threads used by parseBatch(), 0 for one per core
+    int worker_count;
+
+    // Results of the last queries, disabled if its size is 0
+    QueryCache query_cache;
+
+    // Counters of the rules and durations of the steps, disabled by default
+    mutable StatisticsCollector statistics;
 };
 
+Parser::Private *Parser::Private::fromTable(RuleTable &table)
+{
+    if (!table.isValid()) {
+        return 0;
+    }
+
+    Private *rs = new Private(table.stream());
+
+    if (!rs->loadRules(table.stream())) {
+        delete rs;
+        return 0;
+    }
+
+    rs->setupSparqlEmitter();
+
+    return rs;
+}
+
+Parser::Private *Parser::Private::withRules(Parser::RuleSource source)
+{
+#ifdef HAVE_BUILTIN_RULES
+    if (source == Parser::DefaultRules && RuleTable::localeKey() == QLatin1String(builtin_rules.locale_key)) {
+        return new Private(builtin_rules);
+    }
+#else
+    Q_UNUSED(source);
+#endif
+
+    return new Private;
+}
+
 Parser::Parser()
-: d(new Private)
+: d(Private::withRules(DefaultRules))
 {
 }
 
+Parser::Parser(RuleSource source)
+: d(Private::withRules(source))
+{
+}
+
+Parser::Parser(const QString &rule_table)
+{
+    RuleTable table(rule_table);
+
+    d = Private::fromTable(table);
+
+    if (!d) {
+        // Missing, outdated or corrupt table
+        d = Private::withRules(DefaultRules);
+    }
+}
+
 Parser::Parser(const Parser &other)
 : d(new Private(*other.d))
 {
@@ -124,83 +548,476 @@ Parser::~Parser()
     delete d;
 }
 
-void Parser::reset()
+bool Parser::saveRuleTable(const QString &path) const
+{
+    return RuleTable::write(path, d->ruleTableData());
+}
+
+bool Parser::saveRuleSource(const QString &path) const
+{
+    return RuleTable::writeFile(path, d->ruleSource());
+}
+
+void Parser::setMatchingMode(MatchingMode mode)
 {
-    d->terms.clear();
+    d->matching_mode = mode;
 }
 
-Nepomuk2::Query::Query Parser::parse(const QString &query)
+void Parser::setWorkerCount(int count)
 {
-    reset();
+    d->worker_count = count;
+}
 
-    // Split the query into terms
-    QList<int> positions;
-    QStringList parts = d->split(query, true, &positions);
+void Parser::setTagSource(TagSource *source)
+{
+    d->pass_properties.setTagSource(source);
+}
 
-    for (int i=0; i<parts.count(); ++i) {
-        const QString &part = parts.at(i);
-        int position = positions.at(i);
+QStringList Parser::completeTag(const QString &prefix, int max_count) const
+{
+    return d->pass_properties.tagsWithPrefix(prefix, max_count);
+}
 
-        Nepomuk2::Query::LiteralTerm term(part);
-        term.setPosition(position, part.size());
+void Parser::setCacheSize(int max_queries)
+{
+    d->query_cache.setMaxSize(max_queries);
+}
 
-        d->terms.append(term);
+qint64 Parser::cacheHits() const
+{
+    return d->query_cache.hits();
+}
+
+qint64 Parser::cacheMisses() const
+{
+    return d->query_cache.misses();
+}
+
+void Parser::setStatisticsEnabled(bool enabled)
+{
+    d->statistics.setEnabled(enabled);
+}
+
+ParserStatistics Parser::statistics() const
+{
+    return d->statistics.snapshot();
+}
+
+struct ParseSession::Private
+{
+    Private(const Parser &parser)
+    : parser(parser),
+      tag_generation(-1)
+    {}
+
+    const Parser &parser;
+
+    // Text of the last update, its words and the tokens built from them
+    QString text;
+    QVector<Tokenizer::Span> spans;
+    QVector<Token> words;
+
+    // Walks of the matchers, reused while the tags do not change
+    QVector<IncrementalScan> scans;
+    int tag_generation;
+};
+
+ParseSession::ParseSession(const Parser &parser)
+: d(new Private(parser))
+{
+}
+
+ParseSession::~ParseSession()
+{
+    delete d;
+}
+
+Nepomuk2::Query::Query ParseSession::update(const QString &text)
+{
+    return update(text, QDateTime::currentDateTime());
+}
+
+Nepomuk2::Query::Query ParseSession::update(const QString &text, const QDateTime &reference_time)
+{
+    const Parser::Private *parser = d->parser.d;
+    int scan_count = parser->scanCount();
+    int tag_generation = parser->pass_properties.tagGeneration();
+
+    if (tag_generation != d->tag_generation || d->scans.count() != scan_count) {
+        d->scans = QVector<IncrementalScan>(scan_count);
+        d->tag_generation = tag_generation;
+    }
+
+    // Tokenize again only the words that may have been edited
+    int common = 0;
+    int common_max = qMin(text.size(), d->text.size());
+
+    while (common < common_max && text.at(common) == d->text.at(common)) {
+        ++common;
     }
 
+    ParseContext context;
+
+    context.statistics = parser->statistics.shard();
+
+    {
+        StepTimer timer(context.statistics, Parser::Private::TokenizeStep);
+        int restart = parser->tokenizer.restartPosition(text, true, common);
+        int kept = 0;
+
+        while (kept < d->spans.count() && d->spans.at(kept).position < restart) {
+            ++kept;
+        }
+
+        QVector<Tokenizer::Span> spans = parser->tokenizer.tokenize(text, true, restart);
+
+        d->text = text;
+        d->spans.resize(kept);
+        d->spans += spans;
+        d->words.resize(kept);
+        appendWords(d->words, text, spans);
+    }
+
+    // Run the rules, resuming their walks where possible
+    context.tokens = d->words;
+    context.scans = d->scans.data();
+
+    parser->runStages(context);
+
+    Nepomuk2::Query::Query rs;
+
+    {
+        StepTimer timer(context.statistics, Parser::Private::BuildQueryStep);
+
+        rs = buildQuery(context.tokens, *parser->calendar, *parser->keywords, reference_time);
+    }
+
+    return rs;
+}
+
+Parser::BatchHandler::~BatchHandler()
+{
+}
+
+struct QueryTemplate::Private
+{
+    QVector<Token> tokens;
+    QSharedPointer<const Calendar> calendar;
+    QSharedPointer<const FuseKeywords> keywords;
+    QSharedPointer<const SparqlEmitter> sparql_emitter;
+    int now_period;
+};
+
+QueryTemplate::QueryTemplate()
+{
+}
+
+QueryTemplate::QueryTemplate(Private *data)
+: d(data)
+{
+}
+
+bool QueryTemplate::isValid() const
+{
+    return !d.isNull();
+}
+
+bool QueryTemplate::dependsOnReferenceTime() const
+{
+    return d && d->now_period != -1;
+}
+
+Nepomuk2::Query::Query QueryTemplate::instantiate(const QDateTime &reference_time) const
+{
+    if (!d) {
+        return Nepomuk2::Query::Query();
+    }
+
+    return buildQuery(d->tokens, *d->calendar, *d->keywords, reference_time);
+}
+
+QString QueryTemplate::toSparql(const QDateTime &reference_time) const
+{
+    if (!d) {
+        return QString();
+    }
+
+    QVector<Token> tokens = d->tokens;
+
+    resolveDateTimes(tokens, *d->calendar, reference_time);
+
+    return d->sparql_emitter->toSparql(tokens, *d->calendar, *d->keywords);
+}
+
+Nepomuk2::Query::Query Parser::parse(const QString &query) const
+{
+    return parse(query, QDateTime::currentDateTime());
+}
+
+Nepomuk2::Query::Query Parser::parse(const QString &query, const QDateTime &reference_time) const
+{
+    QueryTemplate query_template;
+
+    if (d->query_cache.maxSize() == 0) {
+        return d->parseQuery(query, reference_time, query_template);
+    }
+
+    QString key = d->cacheKey(query);
+    int tag_generation = d->pass_properties.tagGeneration();
+    Nepomuk2::Query::Query rs;
+
+    if (!d->query_cache.find(key, tag_generation, reference_time, rs)) {
+        rs = d->parseQuery(query, reference_time, query_template);
+        d->query_cache.insert(key,
+                              query_template,
+                              rs,
+                              tag_generation,
+                              query_template.d->now_period,
+                              reference_time);
+    }
+
+    return rs;
+}
+
+QString Parser::parseSparql(const QString &query) const
+{
+    return parseSparql(query, QDateTime::currentDateTime());
+}
+
+QString Parser::parseSparql(const QString &query, const QDateTime &reference_time) const
+{
+    // The cache keeps Nepomuk2::Query::Query objects, it is not used here
+    StatisticsCollector::Shard *statistics = d->statistics.shard();
+    QueryTemplate query_template = d->parseTemplate(query, statistics);
+    QString rs;
+
+    {
+        StepTimer timer(statistics, Private::BuildQueryStep);
+
+        rs = query_template.toSparql(reference_time);
+    }
+
+    return rs;
+}
+
+QueryTemplate Parser::parseTemplate(const QString &query) const
+{
+    return d->parseTemplate(query, d->statistics.shard());
+}
+
+QueryTemplate Parser::Private::parseTemplate(const QString &query, StatisticsCollector::Shard *statistics) const
+{
+    ParseContext context;
+
+    context.statistics = statistics;
+
+    // Split the query into tokens
+    {
+        StepTimer timer(statistics, TokenizeStep);
+
+        appendWords(context.tokens, query, tokenizer.tokenize(query, true));
+    }
+
+    runStages(context);
+
+    QueryTemplate::Private *data = new QueryTemplate::Private;
+
+    data->tokens = context.tokens;
+    data->calendar = calendar;
+    data->keywords = keywords;
+    data->sparql_emitter = sparql_emitter;
+    data->now_period = context.now_period;
+
+    return QueryTemplate(data);
+}
+
+Nepomuk2::Query::Query Parser::Private::parseQuery(const QString &query,
+                                                   const QDateTime &reference_time,
+                                                   QueryTemplate &query_template) const
+{
+    StatisticsCollector::Shard *shard = statistics.shard();
+    Nepomuk2::Query::Query rs;
+
+    query_template = parseTemplate(query, shard);
+
+    {
+        StepTimer timer(shard, BuildQueryStep);
+
+        rs = query_template.instantiate(reference_time);
+    }
+
+    return rs;
+}
+
+void Parser::Private::runStages(ParseContext &context) const
+{
     // Prepare literal values
-    d->runPass(d->pass_splitunits, "%1");
-    d->runPass(d->pass_numbers, "%1");
-    d->runPass(d->pass_filesize, "%1 %2");
-    d->runPass(d->pass_typehints, "%1");
+    runStage(context, Private::LiteralValuesStage);
 
     // Date-time periods
-    d->runPass(d->pass_periodnames, "%1");
-
-    d->pass_dateperiods.setKind(PassDatePeriods::VariablePeriod, PassDatePeriods::Offset);
-    d->runPass(d->pass_dateperiods,
-        i18nc("Adding an offset to a period of time (%1=period, %2=offset)", "in %2 %1"));
-
-    d->pass_dateperiods.setKind(PassDatePeriods::VariablePeriod, PassDatePeriods::InvertedOffset);
-    d->runPass(d->pass_dateperiods,
-        i18nc("Removing an offset from a period of time (%1=period, %2=offset)", "%2 %1 ago"));
-
-    d->pass_dateperiods.setKind(PassDatePeriods::VariablePeriod, PassDatePeriods::Offset, 1);
-    d->runPass(d->pass_dateperiods,
-        i18nc("Adding 1 to a period of time", "next %1"));
-
-    d->pass_dateperiods.setKind(PassDatePeriods::VariablePeriod, PassDatePeriods::Offset, -1);
-    d->runPass(d->pass_dateperiods,
-        i18nc("Removing 1 to a period of time", "last %1"));
-
-    d->pass_dateperiods.setKind(PassDatePeriods::Day, PassDatePeriods::Offset, 1);
-    d->runPass(d->pass_dateperiods,
-        i18nc("In one day", "tomorrow"));
-    d->pass_dateperiods.setKind(PassDatePeriods::Day, PassDatePeriods::Offset, -1);
-    d->runPass(d->pass_dateperiods,
-        i18nc("One day ago", "yesterday"));
-    d->pass_dateperiods.setKind(PassDatePeriods::Day, PassDatePeriods::Offset, 0);
-    d->runPass(d->pass_dateperiods,
-        i18nc("The current day", "today"));
-
-    d->pass_dateperiods.setKind(PassDatePeriods::VariablePeriod, PassDatePeriods::Value, 1);
-    d->runPass(d->pass_dateperiods,
-        i18nc("First period (first day, month, etc)", "first %1"));
-    d->pass_dateperiods.setKind(PassDatePeriods::VariablePeriod, PassDatePeriods::Value, -1);
-    d->runPass(d->pass_dateperiods,
-        i18nc("Last period (last day, month, etc)", "last %1"));
-    d->pass_dateperiods.setKind(PassDatePeriods::VariablePeriod, PassDatePeriods::Value);
-    d->runPass(d->pass_dateperiods,
-        i18nc("Setting the value of a period, as in 'third week' (%1=period, %2=value)", "%2 %1"));
+    runStage(context, Private::DatePeriodsStage);
 
     // Setting values of date-time periods (14:30, June 6, etc)
-    d->pass_datevalues.setPm(true);
-    d->runPass(d->pass_datevalues,
-        i18nc("An hour (%5) and an optional minute (%6), PM", "at %5 : %6 pm;at %5 h pm;at %5 pm;%5 : %6 pm;%5 h pm;%5 pm"));
-    d->pass_datevalues.setPm(false);
-    d->runPass(d->pass_datevalues,
-        i18nc("An hour (%5) and an optional minute (%6), AM", "at %5 : %6 am;at %5 h am;at %5 am;at %5;%5 : %6 am;%5 : %6 : %7;%5 : %6;%5 h am;%5 h;%5 am"));
-
-    d->runPass(d->pass_datevalues, i18nc(
+    runStage(context, Private::DateValuesStage);
+
+    // Fold date-time properties into real DateTime values
+    {
+        StepTimer timer(context.statistics, FoldDateTimesStep);
+
+        foldDateTimes(context);
+        context.tokensChanged();
+    }
+
+    // Comparators
+    runStage(context, Private::ComparatorsStage);
+
+    // Properties (email-related, file-related and having a resource range)
+    runStage(context, Private::PropertiesStage);
+
+    // Different kinds of properties that need subqueries
+    runStage(context, Private::SubqueriesStage);
+}
+
+int Parser::Private::scanCount() const
+{
+    int count = 0;
+
+    for (int i=0; i<StageCount; ++i) {
+        count += stages[i].rules.count();
+    }
+
+    return count;
+}
+
+QString Parser::Private::cacheKey(const QString &query) const
+{
+    // Trailing spaces do not change the result. Other spaces and the case of
+    // the query cannot be normalized, as the terms keep their position and
+    // the literal strings their case.
+    int length = query.size();
+
+    while (length > 0 && query.at(length - 1).isSpace()) {
+        --length;
+    }
+
+    // Translations and dates depend on the locale
+    return RuleTable::localeKey() + QLatin1Char(':') + query.left(length);
+}
+
+QList<Nepomuk2::Query::Query> Parser::parseBatch(const QStringList &queries) const
+{
+    return d->parseBlock(this, queries).toList();
+}
+
+void Parser::parseBatch(const QStringList &queries, BatchHandler *handler) const
+{
+    // Parse the batch in blocks, so that the results of a very large batch
+    // are not all kept in memory before being given to the handler
+    static const int block_size = 4096;
+
+    for (int first=0; first<queries.count(); first+=block_size) {
+        QStringList block = queries.mid(first, block_size);
+        QVector<Nepomuk2::Query::Query> results = d->parseBlock(this, block);
+
+        for (int i=0; i<block.count(); ++i) {
+            handler->queryParsed(first + i, block.at(i), results.at(i));
+        }
+    }
+}
+
+QVector<Nepomuk2::Query::Query> Parser::Private::parseBlock(const Parser *parser, const QStringList &queries) const
+{
+    // Identical queries are parsed only once
+    QHash<QString, int> unique_indexes;
+    QStringList unique_queries;
+    QVector<int> query_indexes(queries.count());
+
+    for (int i=0; i<queries.count(); ++i) {
+        const QString &query = queries.at(i);
+        QHash<QString, int>::const_iterator it = unique_indexes.constFind(query);
+
+        if (it != unique_indexes.constEnd()) {
+            query_indexes[i] = it.value();
+        } else {
+            query_indexes[i] = unique_queries.count();
+            unique_indexes.insert(query, unique_queries.count());
+            unique_queries.append(query);
+        }
+    }
+
+    // Parse the unique queries
+    QVector<Nepomuk2::Query::Query> unique_results(unique_queries.count());
+    int chunks = (unique_queries.count() + BatchWorker::ChunkSize - 1) / BatchWorker::ChunkSize;
+    int workers = qMin(worker_count > 0 ? worker_count : QThread::idealThreadCount(), chunks);
+
+    if (workers <= 1) {
+        for (int i=0; i<unique_queries.count(); ++i) {
+            unique_results[i] = parser->parse(unique_queries.at(i));
+        }
+    } else {
+        BatchJob job(unique_queries, unique_results);
+        QThreadPool pool;
+
+        pool.setMaxThreadCount(workers);
+
+        for (int i=0; i<workers; ++i) {
+            pool.start(new BatchWorker(*parser, job));
+        }
+
+        pool.waitForDone();
+    }
+
+    // Results in input order
+    QVector<Nepomuk2::Query::Query> results(queries.count());
+
+    for (int i=0; i<queries.count(); ++i) {
+        results[i] = unique_results.at(query_indexes.at(i));
+    }
+
+    return results;
+}
+
+void Parser::Private::compileRules()
+{
+    // Prepare literal values
+    addRule(LiteralValuesStage, CompiledRule::SplitUnits, "Split units", QLatin1String("%1"));
+    addRule(LiteralValuesStage, CompiledRule::Numbers, "Numbers", QLatin1String("%1"));
+    addRule(LiteralValuesStage, CompiledRule::FileSize, "File sizes", QLatin1String("%1 %2"));
+    addRule(LiteralValuesStage, CompiledRule::TypeHints, "Type hints", QLatin1String("%1"));
+
+    // Date-time periods
+    addRule(DatePeriodsStage, CompiledRule::PeriodNames, "Period names", QLatin1String("%1"));
+
+    addDatePeriodRule(PassDatePeriods::VariablePeriod, PassDatePeriods::Offset, 0,
+        I18N_NOOP2_NOSTRIP("Adding an offset to a period of time (%1=period, %2=offset)", "in %2 %1"));
+    addDatePeriodRule(PassDatePeriods::VariablePeriod, PassDatePeriods::InvertedOffset, 0,
+        I18N_NOOP2_NOSTRIP("Removing an offset from a period of time (%1=period, %2=offset)", "%2 %1 ago"));
+    addDatePeriodRule(PassDatePeriods::VariablePeriod, PassDatePeriods::Offset, 1,
+        I18N_NOOP2_NOSTRIP("Adding 1 to a period of time", "next %1"));
+    addDatePeriodRule(PassDatePeriods::VariablePeriod, PassDatePeriods::Offset, -1,
+        I18N_NOOP2_NOSTRIP("Removing 1 to a period of time", "last %1"));
+
+    addDatePeriodRule(PassDatePeriods::Day, PassDatePeriods::Offset, 1,
+        I18N_NOOP2_NOSTRIP("In one day", "tomorrow"));
+    addDatePeriodRule(PassDatePeriods::Day, PassDatePeriods::Offset, -1,
+        I18N_NOOP2_NOSTRIP("One day ago", "yesterday"));
+    addDatePeriodRule(PassDatePeriods::Day, PassDatePeriods::Offset, 0,
+        I18N_NOOP2_NOSTRIP("The current day", "today"));
+
+    addDatePeriodRule(PassDatePeriods::VariablePeriod, PassDatePeriods::Value, 1,
+        I18N_NOOP2_NOSTRIP("First period (first day, month, etc)", "first %1"));
+    addDatePeriodRule(PassDatePeriods::VariablePeriod, PassDatePeriods::Value, -1,
+        I18N_NOOP2_NOSTRIP("Last period (last day, month, etc)", "last %1"));
+    addDatePeriodRule(PassDatePeriods::VariablePeriod, PassDatePeriods::Value, 0,
+        I18N_NOOP2_NOSTRIP("Setting the value of a period, as in 'third week' (%1=period, %2=value)", "%2 %1"));
+
+    // Setting values of date-time periods (14:30, June 6, etc)
+    addDateValueRule(true,
+        I18N_NOOP2_NOSTRIP("An hour (%5) and an optional minute (%6), PM", "at %5 : %6 pm;at %5 h pm;at %5 pm;%5 : %6 pm;%5 h pm;%5 pm"));
+    addDateValueRule(false,
+        I18N_NOOP2_NOSTRIP("An hour (%5) and an optional minute (%6), AM", "at %5 : %6 am;at %5 h am;at %5 am;at %5;%5 : %6 am;%5 : %6 : %7;%5 : %6;%5 h am;%5 h;%5 am"));
+
+    addDateValueRule(false, I18N_NOOP2_NOSTRIP(
         "A year (%1), month (%2), day (%3), day of week (%4), hour (%5), "
             "minute (%6), second (%7), in every combination supported by your language",
         "%3 of %2 %1;%3 (st|nd|rd|th) %2 %1;%3 (st|nd|rd|th) of %2 %1;"
@@ -209,316 +1026,586 @@ Nepomuk2::Query::Query Parser::parse(const QString &query)
         "in %2 %1; in %1;, %1;"
     ));
 
-    // Fold date-time properties into real DateTime values
-    d->foldDateTimes();
-
     // Comparators
-    d->pass_comparators.setComparator(Nepomuk2::Query::ComparisonTerm::Contains);
-    d->runPass(d->pass_comparators,
-        i18nc("Equality", "(contains|containing) %1"));
-    d->pass_comparators.setComparator(Nepomuk2::Query::ComparisonTerm::Greater);
-    d->runPass(d->pass_comparators,
-        i18nc("Strictly greater", "(greater|bigger|more) than %1;at least %1;after %1;\\> %1"));
-    d->pass_comparators.setComparator(Nepomuk2::Query::ComparisonTerm::Smaller);
-    d->runPass(d->pass_comparators,
-        i18nc("Strictly smaller", "(smaller|less|lesser) than %1;at most %1;before %1;\\< %1"));
-    d->pass_comparators.setComparator(Nepomuk2::Query::ComparisonTerm::Equal);
-    d->runPass(d->pass_comparators,
-        i18nc("Equality", "(equal|equals|=) %1;equal to %1"));
+    addComparatorRule(Nepomuk2::Query::ComparisonTerm::Contains,
+        I18N_NOOP2_NOSTRIP("Equality", "(contains|containing) %1"));
+    addComparatorRule(Nepomuk2::Query::ComparisonTerm::Greater,
+        I18N_NOOP2_NOSTRIP("Strictly greater", "(greater|bigger|more) than %1;at least %1;after %1;\\> %1"));
+    addComparatorRule(Nepomuk2::Query::ComparisonTerm::Smaller,
+        I18N_NOOP2_NOSTRIP("Strictly smaller", "(smaller|less|lesser) than %1;at most %1;before %1;\\< %1"));
+    addComparatorRule(Nepomuk2::Query::ComparisonTerm::Equal,
+        I18N_NOOP2_NOSTRIP("Equality", "(equal|equals|=) %1;equal to %1"));
 
     // Email-related properties
-    d->pass_properties.setProperty(Nepomuk2::Vocabulary::NMO::messageFrom(), PassProperties::String);
-    d->runPass(d->pass_properties,
-        i18nc("Sender of an e-mail", "sent by %1;from %1;sender is %1;sender %1"));
-    d->pass_properties.setProperty(Nepomuk2::Vocabulary::NMO::messageSubject(), PassProperties::String);
-    d->runPass(d->pass_properties,
-        i18nc("Title of an e-mail", "title %1"));
-    d->pass_properties.setProperty(Nepomuk2::Vocabulary::NMO::messageRecipient(), PassProperties::String);
-    d->runPass(d->pass_properties,
-        i18nc("Recipient of an e-mail", "sent to %1;to %1;recipient is %1;recipient %1"));
-    d->pass_properties.setProperty(Nepomuk2::Vocabulary::NMO::sentDate(), PassProperties::DateTime);
-    d->runPass(d->pass_properties,
-        i18nc("Sending date-time", "sent (at|on) %1;sent %1"));
-    d->pass_properties.setProperty(Nepomuk2::Vocabulary::NMO::receivedDate(), PassProperties::DateTime);
-    d->runPass(d->pass_properties,
-        i18nc("Receiving date-time", "received (at|on) %1;received %1"));
+    addPropertyRule(Nepomuk2::Vocabulary::NMO::messageFrom(), PassProperties::String,
+        I18N_NOOP2_NOSTRIP("Sender of an e-mail", "sent by %1;from %1;sender is %1;sender %1"));
+    addPropertyRule(Nepomuk2::Vocabulary::NMO::messageSubject(), PassProperties::String,
+        I18N_NOOP2_NOSTRIP("Title of an e-mail", "title %1"));
+    addPropertyRule(Nepomuk2::Vocabulary::NMO::messageRecipient(), PassProperties::String,
+        I18N_NOOP2_NOSTRIP("Recipient of an e-mail", "sent to %1;to %1;recipient is %1;recipient %1"));
+    addPropertyRule(Nepomuk2::Vocabulary::NMO::sentDate(), PassProperties::DateTime,
+        I18N_NOOP2_NOSTRIP("Sending date-time", "sent (at|on) %1;sent %1"));
+    addPropertyRule(Nepomuk2::Vocabulary::NMO::receivedDate(), PassProperties::DateTime,
+        I18N_NOOP2_NOSTRIP("Receiving date-time", "received (at|on) %1;received %1"));
 
     // File-related properties
-    d->pass_properties.setProperty(Nepomuk2::Vocabulary::NFO::fileSize(), PassProperties::IntegerOrDouble);
-    d->runPass(d->pass_properties,
-        i18nc("Size of a file", "size is %1;size %1;being %1 large;%1 large"));
-    d->pass_properties.setProperty(Nepomuk2::Vocabulary::NFO::fileName(), PassProperties::String);
-    d->runPass(d->pass_properties,
-        i18nc("Name of a file", "name %1;named %1"));
-    d->pass_properties.setProperty(Nepomuk2::Vocabulary::NFO::fileCreated(), PassProperties::DateTime);
-    d->runPass(d->pass_properties,
-        i18nc("Date of creation", "created (at|on) %1;created %1"));
-    d->pass_properties.setProperty(Nepomuk2::Vocabulary::NFO::fileLastModified(), PassProperties::DateTime);
-    d->runPass(d->pass_properties,
-        i18nc("Date of last modification", "(modified|edited) (at|on) %1;(modified|edited) %1"));
+    addPropertyRule(Nepomuk2::Vocabulary::NFO::fileSize(), PassProperties::IntegerOrDouble,
+        I18N_NOOP2_NOSTRIP("Size of a file", "size is %1;size %1;being %1 large;%1 large"));
+    addPropertyRule(Nepomuk2::Vocabulary::NFO::fileName(), PassProperties::String,
+        I18N_NOOP2_NOSTRIP("Name of a file", "name %1;named %1"));
+    addPropertyRule(Nepomuk2::Vocabulary::NFO::fileCreated(), PassProperties::DateTime,
+        I18N_NOOP2_NOSTRIP("Date of creation", "created (at|on) %1;created %1"));
+    addPropertyRule(Nepomuk2::Vocabulary::NFO::fileLastModified(), PassProperties::DateTime,
+        I18N_NOOP2_NOSTRIP("Date of last modification", "(modified|edited) (at|on) %1;(modified|edited) %1"));
 
     // Properties having a resource range (hasTag, messageFrom, etc)
-    d->pass_properties.setProperty(Soprano::Vocabulary::NAO::hasTag(), PassProperties::Tag);
-    d->runPass(d->pass_properties, i18nc(
+    addPropertyRule(Soprano::Vocabulary::NAO::hasTag(), PassProperties::Tag, I18N_NOOP2_NOSTRIP(
         "A document is associated with a tag", "tagged as %1;has tag %1;tag is %1;# %1"));
 
     // Different kinds of properties that need subqueries
-    d->pass_subqueries.setProperty(Nepomuk2::Vocabulary::NIE::relatedTo());
-    d->runPass(d->pass_subqueries,
-        i18nc("Related to a subquery", "related to ... ,"));
+    addTranslatedRule(SubqueriesStage, CompiledRule::Subqueries,
+        I18N_NOOP2_NOSTRIP("Related to a subquery", "related to ... ,")).property = Nepomuk2::Vocabulary::NIE::relatedTo();
+}
 
-    // Fuse the terms into a big AND term and produce the query
-    int end_index;
-    Nepomuk2::Query::Term final_term = fuseTerms(d->terms, 0, end_index);
+static QVector<quint32> captureTypes(const CompiledRule &rule)
+{
+    // Types of tokens that the pass of the rule does not reject at once
+    switch (rule.pass)
+    {
+        case CompiledRule::SplitUnits:
+            return PassSplitUnits::captureTypes();
+        case CompiledRule::Numbers:
+            return PassNumbers::captureTypes();
+        case CompiledRule::FileSize:
+            return PassFileSize::captureTypes();
+        case CompiledRule::TypeHints:
+            return PassTypeHints::captureTypes();
+        case CompiledRule::PeriodNames:
+            return PassPeriodNames::captureTypes();
+
+        case CompiledRule::DatePeriods:
+            return PassDatePeriods::captureTypes(rule.period, rule.value);
+        case CompiledRule::DateValues:
+            return PassDateValues::captureTypes();
+        case CompiledRule::Comparators:
+            return PassComparators::captureTypes();
+        case CompiledRule::Properties:
+            return PassProperties::captureTypes();
+        case CompiledRule::Subqueries:
+            break;
+    }
 
-    return Nepomuk2::Query::Query(final_term);
+    return QVector<quint32>();
 }
 
-QStringList Parser::Private::split(const QString &query, bool split_separators, QList<int> *positions)
+Rule Parser::Private::compileRule(const QString &pattern, const QVector<quint32> &capture_types)
 {
-    QStringList parts;
-    QString part;
-    int size = query.size();
-    bool between_quotes = false;
+    Rule rule;
 
-    for (int i=0; i<size; ++i) {
-        QChar c = query.at(i);
+    // Split the pattern at ";" characters, as a locale can have more than one
+    // pattern that can be used for a given rule
+    Q_FOREACH(const QString &alternative, pattern.split(QLatin1Char(';'))) {
+        QList<PatternAtom> atoms;
 
-        if (!between_quotes && (c.isSpace() || (split_separators && separators.contains(c)))) {
-            // A part may be empty if more than one space are found in block in the input
-            if (part.size() > 0) {
-                parts.append(part);
-                part.clear();
-            }
+        // Split the alternative into parts that have to be matched
+        Q_FOREACH(const Tokenizer::Span &span, tokenizer.tokenize(alternative, false)) {
+            atoms.append(PatternAtom(Tokenizer::spanText(alternative, span)));
+        }
 
-            // Add a separator, if any
-            if (split_separators && separators.contains(c)) {
-                if (positions) {
-                    positions->append(i);
-                }
+        rule.addPattern(Pattern(atoms, capture_types));
+    }
 
-                parts.append(QString(c));
-            }
-        } else if (c == '"') {
-            between_quotes = !between_quotes;
-        } else {
-            if (positions && part.size() == 0) {
-                // Start of a new part, save its position in the stream
-                positions->append(i);
-            }
+    return rule;
+}
 
-            part.append(c);
-        }
-    }
+CompiledRule &Parser::Private::addRule(StageId stage_id,
+                                       const CompiledRule &config,
+                                       const char *name,
+                                       const QString &pattern)
+{
+    CompiledRule rule(config);
+
+    rule.name = QLatin1String(name);
+    rule.rule = compileRule(pattern, captureTypes(rule));
 
-    if (part.size() > 0) {
-        parts.append(part);
+    return addCompiledRule(stage_id, rule);
+}
+
+CompiledRule &Parser::Private::addCompiledRule(StageId stage_id, const CompiledRule &rule)
+{
+    Stage &stage = stages[stage_id];
+    const PatternAutomaton &automaton = rule.rule.automaton();
+
+    // Register the patterns of the rule in the automaton of its stage
+    for (int i=0; i<automaton.patternCount(); ++i) {
+        stage.automaton.addPattern(automaton.pattern(i));
+        stage.pattern_rules.append(stage.rules.count());
     }
 
-    return parts;
+    return registerRule(stage_id, rule);
 }
 
-template<typename T>
-void Parser::Private::runPass(const T &pass, const QString &pattern)
+CompiledRule &Parser::Private::registerRule(StageId stage_id, const CompiledRule &compiled_rule)
 {
-    // Split the pattern at ";" characters, as a locale can have more than one
-    // pattern that can be used for a given rule
-    QStringList rules = pattern.split(QLatin1Char(';'));
+    static const char *stage_names[StageCount] = {
+        "literal_values", "date_periods", "date_values", "comparators", "properties", "subqueries"
+    };
+
+    Stage &stage = stages[stage_id];
+    CompiledRule rule(compiled_rule);
+
+    rule.index = statistics.ruleCount();
+    statistics.addRule(rule.name, QLatin1String(stage_names[stage_id]));
+    stage.rules.append(rule);
+
+    return stage.rules.last();
+}
+
+CompiledRule &Parser::Private::addTranslatedRule(StageId stage_id,
+                                                 const CompiledRule &config,
+                                                 const char *context,
+                                                 const char *pattern)
+{
+    // The rule is named after the context of its translation, that is the
+    // same in every locale
+    return addRule(stage_id, config, context, i18nc(context, pattern));
+}
 
-    Q_FOREACH(const QString &rule, rules) {
-        // Split the rule into parts that have to be matched
-        QStringList parts = split(rule, false);
-        PatternMatcher matcher(terms, parts);
+void Parser::Private::addDatePeriodRule(PassDatePeriods::Period period,
+                                        PassDatePeriods::ValueType value_type,
+                                        int value,
+                                        const char *context,
+                                        const char *pattern)
+{
+    CompiledRule rule(CompiledRule::DatePeriods);
+
+    rule.period = period;
+    rule.value_type = value_type;
+    rule.value = value;
+
+    addTranslatedRule(DatePeriodsStage, rule, context, pattern);
+}
 
-        matcher.runPass(pass);
+void Parser::Private::addDateValueRule(bool pm, const char *context, const char *pattern)
+{
+    CompiledRule rule(CompiledRule::DateValues);
+
+    rule.pm = pm;
+
+    addTranslatedRule(DateValuesStage, rule, context, pattern);
+}
+
+void Parser::Private::addComparatorRule(Nepomuk2::Query::ComparisonTerm::Comparator comparator,
+                                        const char *context,
+                                        const char *pattern)
+{
+    CompiledRule rule(CompiledRule::Comparators);
+
+    rule.comparator = comparator;
+
+    addTranslatedRule(ComparatorsStage, rule, context, pattern);
+}
+
+void Parser::Private::addPropertyRule(const QUrl &property,
+                                      PassProperties::Types range,
+                                      const char *context,
+                                      const char *pattern)
+{
+    CompiledRule rule(CompiledRule::Properties);
+
+    rule.property = property;
+    rule.range = range;
+
+    addTranslatedRule(PropertiesStage, rule, context, pattern);
+}
+
+QByteArray Parser::Private::ruleTableData() const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+
+    stream.setVersion(QDataStream::Qt_4_8);
+
+    // Same order as in Parser::Private(QDataStream &)
+    pass_splitunits.save(stream);
+    pass_numbers.save(stream);
+    pass_filesize.save(stream);
+    pass_typehints.save(stream);
+    pass_dateperiods.save(stream);
+    pass_periodnames.save(stream);
+    stream << tokenizer.separatorCharacters();
+    saveRules(stream);
+
+    return data;
+}
+
+void Parser::Private::saveRules(QDataStream &stream) const
+{
+    for (int s=0; s<StageCount; ++s) {
+        const Stage &stage = stages[s];
+
+        stream << qint32(stage.rules.count());
+
+        Q_FOREACH(const CompiledRule &rule, stage.rules) {
+            // The atoms are stored already split, they are only classified
+            // again when the table is loaded
+            const PatternAutomaton &automaton = rule.rule.automaton();
+            QList<QStringList> patterns;
+
+            for (int i=0; i<automaton.patternCount(); ++i) {
+                QStringList atoms;
+
+                Q_FOREACH(const PatternAtom &atom, automaton.pattern(i).atoms()) {
+                    atoms.append(atom.pattern());
+                }
+
+                patterns.append(atoms);
+            }
+
+            stream << qint32(rule.pass) << rule.name << patterns
+                   << qint32(rule.period) << qint32(rule.value_type) << qint32(rule.value)
+                   << rule.pm << qint32(rule.comparator) << rule.property << qint32(rule.range);
+        }
     }
 }
 
-/*
- * Datetime-folding
- */
-void Parser::Private::handleDateTimeComparison(DateTimeSpec &spec, const Nepomuk2::Query::ComparisonTerm &term)
+bool Parser::Private::loadRules(QDataStream &stream)
 {
-    QUrl property_url = term.property().uri(); // URL like date://<property>/<offset|value>
-    int value = term.subTerm().toLiteralTerm().value().toInt();
+    // Placeholders of the rules go from %1 to %9
+    static const int max_captures = 9;
+
+    // The vocabularies read before the rules may already be corrupt
+    if (stream.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    for (int s=0; s<StageCount; ++s) {
+        qint32 rule_count;
+
+        stream >> rule_count;
+
+        for (int r=0; r<rule_count && stream.status() == QDataStream::Ok; ++r) {
+            qint32 pass, period, value_type, value, comparator, range;
+            QString name;
+            QList<QStringList> patterns;
+            bool pm;
+            QUrl property;
+
+            stream >> pass >> name >> patterns
+                   >> period >> value_type >> value
+                   >> pm >> comparator >> property >> range;
+
+            // The enumerations are checked before being cast, a corrupt table
+            // is rejected as a whole
+            if (pass < CompiledRule::SplitUnits || pass > CompiledRule::Subqueries ||
+                period < 0 || period > PassDatePeriods::MaxPeriod ||
+                value_type < PassDatePeriods::Value || value_type > PassDatePeriods::InvertedOffset ||
+                comparator < Nepomuk2::Query::ComparisonTerm::Contains ||
+                comparator > Nepomuk2::Query::ComparisonTerm::SmallerOrEqual ||
+                range < PassProperties::Integer || range > PassProperties::Tag) {
+                return false;
+            }
+
+            CompiledRule rule((CompiledRule::PassKind(pass)));
+
+            rule.name = name;
+            rule.period = PassDatePeriods::Period(period);
+            rule.value_type = PassDatePeriods::ValueType(value_type);
+            rule.value = value;
+            rule.pm = pm;
+            rule.comparator = Nepomuk2::Query::ComparisonTerm::Comparator(comparator);
+            rule.property = property;
+            rule.range = PassProperties::Types(range);
+
+            // The capture types are not stored, they follow from the
+            // configuration of the pass
+            QVector<quint32> capture_types = captureTypes(rule);
+
+            Q_FOREACH(const QStringList &atoms, patterns) {
+                QList<PatternAtom> pattern_atoms;
+
+                Q_FOREACH(const QString &atom, atoms) {
+                    PatternAtom pattern_atom(atom);
 
-    // Populate the field corresponding to the property being compared to
-    Field &field = spec.fields[pass_dateperiods.periodFromName(property_url.host())];
+                    // The matches reserve room for every capture
+                    if (pattern_atom.kind() == PatternAtom::Placeholder &&
+                        (pattern_atom.captureIndex() < 0 || pattern_atom.captureIndex() >= max_captures)) {
+                        return false;
+                    }
 
-    field.value = value;
-    field.flags =
-        (property_url.path() == QLatin1String("/offset") ? Field::Relative : Field::Absolute);
+                    pattern_atoms.append(pattern_atom);
+                }
+
+                rule.rule.addPattern(Pattern(pattern_atoms, capture_types));
+            }
+
+            addCompiledRule(StageId(s), rule);
+        }
+    }
+
+    return stream.status() == QDataStream::Ok;
 }
 
-static int fieldIsRelative(const Field &field, int if_yes, int if_no)
+void Parser::Private::loadBuiltinRules(const BuiltinRules &rules)
 {
-    return (field.flags == Field::Relative ? if_yes : if_no);
+    // The tables are generated from the rules of this very program, they are
+    // not checked again
+    for (int s=0; s<StageCount; ++s) {
+        const BuiltinStage &builtin_stage = rules.stages[s];
+        Stage &stage = stages[s];
+
+        for (int r=0; r<builtin_stage.rule_count; ++r) {
+            const BuiltinRule &builtin_rule = builtin_stage.rules[r];
+            CompiledRule rule((CompiledRule::PassKind(builtin_rule.pass)));
+
+            rule.rule = Rule(PatternAutomaton(*builtin_rule.automaton));
+            rule.name = QString::fromUtf8(builtin_rule.name);
+            rule.period = PassDatePeriods::Period(builtin_rule.period);
+            rule.value_type = PassDatePeriods::ValueType(builtin_rule.value_type);
+            rule.value = builtin_rule.value;
+            rule.pm = builtin_rule.pm;
+            rule.comparator = Nepomuk2::Query::ComparisonTerm::Comparator(builtin_rule.comparator);
+            rule.property = QUrl::fromEncoded(builtin_rule.property);
+            rule.range = PassProperties::Types(builtin_rule.range);
+
+            registerRule(StageId(s), rule);
+        }
+
+        stage.automaton = PatternAutomaton(*builtin_stage.automaton);
+
+        for (int i=0; i<stage.automaton.patternCount(); ++i) {
+            stage.pattern_rules.append(builtin_stage.pattern_rules[i]);
+        }
+    }
 }
 
-static int fieldValue(const Field &field, bool in_defined_period, int now_value, int null_value)
+template<typename T>
+static QHash<QString, qint64> wordValues(const QHash<QString, T> &words)
 {
-    switch (field.flags)
-    {
-        case Field::Unset:
-            return (in_defined_period ? now_value : null_value);
-        case Field::Absolute:
-            return field.value;
-        case Field::Relative:
-            return now_value;
+    QHash<QString, qint64> rs;
+
+    for (typename QHash<QString, T>::const_iterator it = words.constBegin(); it != words.constEnd(); ++it) {
+        rs.insert(it.key(), qint64(it.value()));
     }
 
-    return 0;
+    return rs;
 }
 
-static Nepomuk2::Query::LiteralTerm buildDateTimeLiteral(const DateTimeSpec &spec)
+QByteArray Parser::Private::ruleSource() const
 {
-    KCalendarSystem *calendar = KCalendarSystem::create(KGlobal::locale()->calendarSystem());
-    QDate cdate = QDate::currentDate();
-    QTime ctime = QTime::currentTime();
+    // Same layout as BuiltinRules
+    RuleSourceWriter writer;
+    QHash<QString, qint64> split_units;
+    QHash<QString, qint64> type_hints;
+    QStringList type_urls;
+
+    Q_FOREACH(const QString &unit, pass_splitunits.units()) {
+        split_units.insert(unit, 0);
+    }
 
-    const Field &year = spec.fields[PassDatePeriods::Year];
-    const Field &month = spec.fields[PassDatePeriods::Month];
-    const Field &week = spec.fields[PassDatePeriods::Week];
-    const Field &dayofweek = spec.fields[PassDatePeriods::DayOfWeek];
-    const Field &day = spec.fields[PassDatePeriods::Day];
-    const Field &hour = spec.fields[PassDatePeriods::Hour];
-    const Field &minute = spec.fields[PassDatePeriods::Minute];
-    const Field &second = spec.fields[PassDatePeriods::Second];
+    for (QHash<QString, QUrl>::const_iterator it = pass_typehints.hints().constBegin();
+         it != pass_typehints.hints().constEnd(); ++it) {
+        QString url = QString::fromLatin1(it.value().toEncoded());
 
-    // Last defined period
-    PassDatePeriods::Period last_defined_date = PassDatePeriods::Day;   // If no date is given, use the current date-time
-    PassDatePeriods::Period last_defined_time = PassDatePeriods::Year;  // If no time is given, use 00:00:00
+        if (!type_urls.contains(url)) {
+            type_urls.append(url);
+        }
 
-    if (day.flags != Field::Unset) {
-        last_defined_date = PassDatePeriods::Day;
-    } else if (dayofweek.flags != Field::Unset) {
-        last_defined_date = PassDatePeriods::DayOfWeek;
-    } else if (week.flags != Field::Unset) {
-        last_defined_date = PassDatePeriods::Week;
-    } else if (month.flags != Field::Unset) {
-        last_defined_date = PassDatePeriods::Month;
-    } else if (year.flags != Field::Unset) {
-        last_defined_date = PassDatePeriods::Year;
+        type_hints.insert(it.key(), type_urls.indexOf(url));
     }
 
-    if (second.flags != Field::Unset) {
-        last_defined_time = PassDatePeriods::Second;
-    } else if (minute.flags != Field::Unset) {
-        last_defined_time = PassDatePeriods::Minute;
-    } else if (hour.flags != Field::Unset) {
-        last_defined_time = PassDatePeriods::Hour;
+    QList<QByteArray> fields;
+
+    fields << RuleSourceWriter::string(RuleTable::localeKey())
+           << RuleSourceWriter::string(tokenizer.separatorCharacters())
+           << writer.addWords(split_units)
+           << writer.addWords(wordValues(pass_numbers.names()))
+           << writer.addWords(wordValues(pass_filesize.units()))
+           << writer.addWords(type_hints)
+           << writer.addStrings(type_urls)
+           << writer.addWords(wordValues(pass_dateperiods.names()))
+           << writer.addWords(wordValues(pass_periodnames.dayNames()))
+           << writer.addWords(wordValues(pass_periodnames.monthNames()));
+
+    QList<QByteArray> builtin_stages;
+
+    for (int s=0; s<StageCount; ++s) {
+        const Stage &stage = stages[s];
+        QList<QByteArray> rules;
+        QList<QByteArray> pattern_rules;
+
+        Q_FOREACH(const CompiledRule &rule, stage.rules) {
+            rules.append(RuleSourceWriter::record(QList<QByteArray>()
+                << RuleSourceWriter::number(rule.pass)
+                << RuleSourceWriter::string(rule.name)
+                << RuleSourceWriter::number(rule.period)
+                << RuleSourceWriter::number(rule.value_type)
+                << RuleSourceWriter::number(rule.value)
+                << (rule.pm ? "true" : "false")
+                << RuleSourceWriter::number(rule.comparator)
+                << RuleSourceWriter::string(QString::fromLatin1(rule.property.toEncoded()))
+                << RuleSourceWriter::number(rule.range)
+                << writer.addAutomaton(rule.rule.automaton())));
+        }
+
+        Q_FOREACH(int rule, stage.pattern_rules) {
+            pattern_rules.append(RuleSourceWriter::number(rule));
+        }
+
+        builtin_stages.append(RuleSourceWriter::record(QList<QByteArray>()
+            << writer.addArray("BuiltinRule", rules)
+            << RuleSourceWriter::number(rules.count())
+            << writer.addAutomaton(stage.automaton)
+            << writer.addArray("int", pattern_rules)));
     }
 
-    // Absolute year, month, day of month
-    QDate date;
+    fields << RuleSourceWriter::record(builtin_stages);
 
-    if (month.flags != Field::Unset)
-    {
-        // Month set, day of month
-        calendar->setDate(
-            date,
-            fieldValue(year, last_defined_date >= PassDatePeriods::Year, calendar->year(cdate), 1),
-            fieldValue(month, last_defined_date >= PassDatePeriods::Month, calendar->month(cdate), 1),
-            fieldValue(day, last_defined_date >= PassDatePeriods::Day, calendar->day(cdate), 1)
-        );
-    } else {
-        calendar->setDate(
-            date,
-            fieldValue(year, last_defined_date >= PassDatePeriods::Year, calendar->year(cdate), 1),
-            fieldValue(day, last_defined_date >= PassDatePeriods::Week, calendar->dayOfYear(cdate), 1)
-        );
+    return writer.source(RuleSourceWriter::record(fields));
+}
+
+static bool ruleCanMatch(const Rule &rule, ParseContext &context)
+{
+    // Rules having a pattern without literal words cannot be skipped, and
+    // the words of the query are not even computed for them
+    return !rule.isAnchored() || rule.canMatch(context.words());
+}
+
+static void skipWalk(IncrementalScan *scan)
+{
+    // The tokens are not changed by a matcher that does not run, but the
+    // walk of a ParseSession has to start over the next time
+    if (scan) {
+        *scan = IncrementalScan();
     }
+}
 
-    // Absolute week and day of week
-    int isoyear;
-    int isoweek = calendar->week(date, KLocale::IsoWeekNumber, &isoyear);
-    int isoday = calendar->dayOfWeek(date);
+void Parser::Private::runStage(ParseContext &context, StageId stage_id) const
+{
+    const Stage &stage = stages[stage_id];
+    StepTimer timer(context.statistics, stage_id);
+
+    // Both modes run the rules in order, a rule only sees the tokens left by
+    // the previous ones. The stage matcher shares the matches of the patterns
+    // of the stage between its rules.
+    StageMatcher stage_matcher(context.tokens, stage.automaton);
+
+    for (int r=0; r<stage.rules.count(); ++r) {
+        const CompiledRule &rule = stage.rules.at(r);
+        IncrementalScan *scan = context.nextScan();
+        int attempts;
+
+        // A query not containing the literal words of any pattern of the
+        // rule is not walked
+        if (!ruleCanMatch(rule.rule, context)) {
+            skipWalk(scan);
+            continue;
+        }
 
-    calendar->setDateIsoWeek(
-        date,
-        isoyear,
-        (week.flags == Field::Absolute && month.flags != Field::Unset) ?
-            // Week of month, isoweek is the first week of the month
-            isoweek + (week.value - 1) :
-            // Week of year (or no week at all)
-            fieldValue(week, last_defined_date >= PassDatePeriods::Week, isoweek, isoweek),
-        fieldValue(dayofweek, last_defined_date >= PassDatePeriods::DayOfWeek, isoday, 1)
-    );
+        if (matching_mode == Parser::StageMatching) {
+            attempts = stage_matcher.runPasses(StageRunner(this, stage, r, context), scan);
+        } else {
+            PatternMatcher matcher(context.tokens, rule.rule);
+            attempts = matcher.runPass(RuleRunner(this, rule, context), scan);
+        }
 
-    // Relative year, month, week, day of month
-    if (year.flags == Field::Relative) {
-        date = calendar->addYears(date, year.value);
+        if (context.statistics) {
+            context.statistics->addAttempts(rule.index, attempts);
+        }
     }
-    if (month.flags == Field::Relative) {
-        date = calendar->addMonths(date, month.value);
+}
+
+QVector<Token> Parser::Private::runCountedRule(const CompiledRule &rule,
+                                               const QVector<Token> &match,
+                                               ParseContext &context) const
+{
+    QVector<Token> rs = runRule(rule, match);
+
+    if (context.statistics) {
+        context.statistics->addMatch(rule.index, rs.count() > 0);
     }
-    if (week.flags == Field::Relative) {
-        date = calendar->addDays(date, week.value * calendar->daysInWeek(date));
+
+    // The matched tokens are replaced, the words of the query are computed
+    // again only if a later rule needs them
+    if (rs.count() > 0) {
+        context.tokensChanged();
     }
-    if (day.flags == Field::Relative) {
-        date = calendar->addDays(date, day.value);
+
+    return rs;
+}
+
+QVector<Token> Parser::Private::runRule(const CompiledRule &rule,
+                                        const QVector<Token> &match) const
+{
+    switch (rule.pass)
+    {
+        case CompiledRule::SplitUnits:
+            return pass_splitunits.run(match);
+        case CompiledRule::Numbers:
+            return pass_numbers.run(match);
+        case CompiledRule::FileSize:
+            return pass_filesize.run(match);
+        case CompiledRule::TypeHints:
+            return pass_typehints.run(match);
+        case CompiledRule::PeriodNames:
+            return pass_periodnames.run(match);
+
+        case CompiledRule::DatePeriods:
+            return pass_dateperiods.run(match, rule.period, rule.value_type, rule.value);
+        case CompiledRule::DateValues:
+            return pass_datevalues.run(match, rule.pm);
+        case CompiledRule::Comparators:
+            return pass_comparators.run(match, rule.comparator);
+        case CompiledRule::Properties:
+            return pass_properties.run(match, rule.property, rule.range);
+        case CompiledRule::Subqueries:
+            return pass_subqueries.run(match, rule.property);
     }
 
-    // Absolute time
-    QTime time = QTime(
-        fieldValue(hour, last_defined_time >= PassDatePeriods::Hour, ctime.hour(), 0),
-        fieldValue(minute, last_defined_time >= PassDatePeriods::Minute, ctime.minute(), 0),
-        fieldValue(second, last_defined_time >= PassDatePeriods::Second, ctime.second(), 0)
-    );
+    return QVector<Token>();
+}
 
-    // Relative time
-    QDateTime rs(date, time);
+/*
+ * Datetime-folding
+ */
+static Token dateTimeToken(const DateTimeSpec &spec, const Calendar &calendar, ParseContext &context)
+{
+    int now_period = spec.nowPeriod();
 
-    rs = rs.addSecs(
-        fieldIsRelative(hour, hour.value * 60 * 60, 0) +
-        fieldIsRelative(minute, minute.value * 60, 0) +
-        fieldIsRelative(second, second.value, 0)
-    );
+    if (now_period == -1) {
+        // Absolute date-time, the reference time given to resolve() is not used
+        return Token::fromDateTime(spec.resolve(calendar, QDateTime(QDate(2000, 1, 1))));
+    }
 
-    // Store the last defined period in the millisecond part of the date-time.
-    // This way, equality comparisons with a date-time can be changed to comparisons
-    // against an interval whose size is defined by the last defined period.
-    rs = rs.addMSecs(
-        qMax(last_defined_date, last_defined_time)
-    );
+    // Date-times depending on the reference time stay symbolic until the
+    // query is built
+    context.now_period = qMax(context.now_period, now_period);
 
-    delete calendar;
-    return Nepomuk2::Query::LiteralTerm(rs);
+    return Token::fromDateTimeSpec(spec);
 }
 
-void Parser::Private::foldDateTimes()
+void Parser::Private::foldDateTimes(ParseContext &context) const
 {
-    QList<Nepomuk2::Query::Term> new_terms;
+    QVector<Token> new_tokens;
 
     DateTimeSpec spec;
     bool spec_contains_interesting_data = false;
     int start_position = 1 << 30;
     int end_position = 0;
 
-    spec.reset();
+    Q_FOREACH(const Token &token, context.tokens) {
+        if (token.kind == Token::DatePeriod && !token.isComparison()) {
+            spec.setPeriod(token);
 
-    Q_FOREACH(const Nepomuk2::Query::Term &term, terms) {
-        bool comparison_encountered = false;
+            spec_contains_interesting_data = true;
 
-        if (term.isComparisonTerm()) {
-            Nepomuk2::Query::ComparisonTerm comparison = term.toComparisonTerm();
-
-            if (comparison.property().uri().scheme() == QLatin1String("date")) {
-                handleDateTimeComparison(spec, comparison);
-
-                spec_contains_interesting_data = true;
-                comparison_encountered = true;
-
-                start_position = qMin(start_position, term.position());
-                end_position = qMax(end_position, term.position() + term.length());
-            }
-        }
-
-        if (!comparison_encountered) {
+            start_position = qMin(start_position, token.position);
+            end_position = qMax(end_position, token.position + token.length);
+        } else {
             if (spec_contains_interesting_data) {
                 // End a date-time spec and emit its xsd:DateTime value
-                new_terms.append(buildDateTimeLiteral(spec));
-                new_terms.last().setPosition(start_position, end_position - start_position);
+                new_tokens.append(dateTimeToken(spec, *calendar, context));
+                new_tokens.last().setPosition(start_position, end_position - start_position);
 
                 spec.reset();
                 spec_contains_interesting_data = false;
@@ -526,15 +1613,15 @@ void Parser::Private::foldDateTimes()
                 end_position = 0;
             }
 
-            new_terms.append(term);     // Preserve non-datetime terms
+            new_tokens.append(token);   // Preserve non-datetime tokens
         }
     }
 
     if (spec_contains_interesting_data) {
         // Query ending with a date-time, don't forget to build it
-        new_terms.append(buildDateTimeLiteral(spec));
-        new_terms.last().setPosition(start_position, end_position - start_position);
+        new_tokens.append(dateTimeToken(spec, *calendar, context));
+        new_tokens.last().setPosition(start_position, end_position - start_position);
     }
 
-    terms.swap(new_terms);
+    context.tokens.swap(new_tokens);
 }
\ No newline at end of file
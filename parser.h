@@ -21,17 +21,131 @@
 #define __PARSER_H__
 
 #include <QString>
+#include <QStringList>
+#include <QList>
+#include <QDateTime>
+#include <QSharedPointer>
 #include <nepomuk2/query.h>
 
+#include "statistics.h"
+
+class TagSource;
+
+/**
+ * Query parsed once and built for any reference time.
+ *
+ * The relative date-times of the query ("yesterday", "last week") are kept
+ * symbolic and resolved by instantiate(), that is much cheaper than parsing
+ * the query again. Templates are immutable and can be shared by threads.
+ */
+class QueryTemplate
+{
+    public:
+        QueryTemplate();
+
+        bool isValid() const;
+        bool dependsOnReferenceTime() const;
+        Nepomuk2::Query::Query instantiate(const QDateTime &reference_time) const;
+        QString toSparql(const QDateTime &reference_time) const;
+
+    private:
+        friend class Parser;
+
+        struct Private;
+
+        QueryTemplate(Private *data);
+
+    private:
+        QSharedPointer<const Private> d;
+};
+
 class Parser
 {
+    public:
+        enum MatchingMode {
+            SequentialMatching,     // Every pattern of every rule scans the whole query
+            StageMatching           // The rules of a stage share the matches of its automaton
+        };
+
+        enum RuleSource {
+            DefaultRules,           // Built-in table if it matches the locale, translated rules otherwise
+            TranslatedRules         // Always translate and compile the rules
+        };
+
+        // Receives the queries parsed by parseBatch(), in input order
+        class BatchHandler
+        {
+            public:
+                virtual ~BatchHandler();
+
+                virtual void queryParsed(int index,
+                                         const QString &query,
+                                         const Nepomuk2::Query::Query &result) = 0;
+        };
+
     public:
         Parser();
+        explicit Parser(RuleSource source);
+        explicit Parser(const QString &rule_table);
         Parser(const Parser &other);
         ~Parser();
 
-        void reset();
-        Nepomuk2::Query::Query parse(const QString &query);
+        void setMatchingMode(MatchingMode mode);
+        Nepomuk2::Query::Query parse(const QString &query) const;
+        Nepomuk2::Query::Query parse(const QString &query, const QDateTime &reference_time) const;
+        QueryTemplate parseTemplate(const QString &query) const;
+
+        // SPARQL query written directly from the tokens, selecting the same
+        // resources as parse(query).toSparqlQuery()
+        QString parseSparql(const QString &query) const;
+        QString parseSparql(const QString &query, const QDateTime &reference_time) const;
+
+        // Rule tables are bound to the locale, a parser built from a table
+        // of another locale or version translates its rules again
+        bool saveRuleTable(const QString &path) const;
+        bool saveRuleSource(const QString &path) const;
+
+        void setWorkerCount(int count);
+        void setTagSource(TagSource *source);
+        QStringList completeTag(const QString &prefix, int max_count = 10) const;
+
+        QList<Nepomuk2::Query::Query> parseBatch(const QStringList &queries) const;
+        void parseBatch(const QStringList &queries, BatchHandler *handler) const;
+
+        void setCacheSize(int max_queries);
+        qint64 cacheHits() const;
+        qint64 cacheMisses() const;
+
+        void setStatisticsEnabled(bool enabled);
+        ParserStatistics statistics() const;
+
+    private:
+        friend class ParseSession;
+
+        struct Private;
+        Private *d;
+};
+
+/**
+ * Parses a text that changes a little at a time, for instance while the user
+ * types it in a search bar.
+ *
+ * Only the words near the edited part of the text are tokenized again, and
+ * the rules resume from the last point where they had not read the edited
+ * part yet. The parser must outlive the session.
+ */
+class ParseSession
+{
+    public:
+        explicit ParseSession(const Parser &parser);
+        ~ParseSession();
+
+        Nepomuk2::Query::Query update(const QString &text);
+        Nepomuk2::Query::Query update(const QString &text, const QDateTime &reference_time);
+
+    private:
+        ParseSession(const ParseSession &other);
+        ParseSession &operator=(const ParseSession &other);
 
     private:
         struct Private;
@@ -0,0 +1,80 @@
+######################################################################
+# Sources shared by the parser and by the programs built from it
+######################################################################
+
+CONFIG += debug
+DEPENDPATH += $$PWD
+INCLUDEPATH += $$PWD
+QT -= gui
+LIBS += -lnepomukcore -lkdecore -lsoprano
+
+# Input
+HEADERS += $$PWD/parser.h \
+           $$PWD/benchmark.h \
+           $$PWD/patternatom.h \
+           $$PWD/patternmatcher.h \
+           $$PWD/patternautomaton.h \
+           $$PWD/stagematcher.h \
+           $$PWD/tagsource.h \
+           $$PWD/tagindex.h \
+           $$PWD/tagcache.h \
+           $$PWD/nepomuktagsource.h \
+           $$PWD/rule.h \
+           $$PWD/token.h \
+           $$PWD/tokenizer.h \
+           $$PWD/querycache.h \
+           $$PWD/statistics.h \
+           $$PWD/ruletable.h \
+           $$PWD/rulesource.h \
+           $$PWD/builtinrules.h \
+           $$PWD/server.h \
+           $$PWD/sparqlemitter.h \
+           $$PWD/incrementalscan.h \
+           $$PWD/calendar.h \
+           $$PWD/datetimespec.h \
+           $$PWD/utils.h \
+           $$PWD/pass_splitunits.h \
+           $$PWD/pass_numbers.h \
+           $$PWD/pass_filesize.h \
+           $$PWD/pass_typehints.h \
+           $$PWD/pass_properties.h \
+           $$PWD/pass_dateperiods.h \
+           $$PWD/pass_datevalues.h \
+           $$PWD/pass_periodnames.h \
+           $$PWD/pass_subqueries.h \
+           $$PWD/pass_comparators.h
+
+SOURCES += $$PWD/benchmark.cpp \
+           $$PWD/patternatom.cpp \
+           $$PWD/patternmatcher.cpp \
+           $$PWD/patternautomaton.cpp \
+           $$PWD/stagematcher.cpp \
+           $$PWD/tagsource.cpp \
+           $$PWD/tagindex.cpp \
+           $$PWD/tagcache.cpp \
+           $$PWD/nepomuktagsource.cpp \
+           $$PWD/rule.cpp \
+           $$PWD/token.cpp \
+           $$PWD/tokenizer.cpp \
+           $$PWD/querycache.cpp \
+           $$PWD/statistics.cpp \
+           $$PWD/ruletable.cpp \
+           $$PWD/rulesource.cpp \
+           $$PWD/server.cpp \
+           $$PWD/sparqlemitter.cpp \
+           $$PWD/incrementalscan.cpp \
+           $$PWD/calendar.cpp \
+           $$PWD/datetimespec.cpp \
+           $$PWD/utils.cpp \
+           $$PWD/parser.cpp \
+           $$PWD/pass_splitunits.cpp \
+           $$PWD/pass_numbers.cpp \
+           $$PWD/pass_filesize.cpp \
+           $$PWD/pass_typehints.cpp \
+           $$PWD/pass_properties.cpp \
+           $$PWD/pass_dateperiods.cpp \
+           $$PWD/pass_datevalues.cpp \
+           $$PWD/pass_periodnames.cpp \
+           $$PWD/pass_subqueries.cpp \
+           $$PWD/pass_comparators.cpp
+
@@ -2,40 +2,47 @@
 # Automatically generated by qmake (2.01a) Thu Jun 13 13:23:31 2013
 ######################################################################
 
-CONFIG += debug
 TEMPLATE = app
 TARGET = parser
-DEPENDPATH += .
-INCLUDEPATH += .
-QT -= gui
-LIBS += -lnepomukcore -lkdecore -lsoprano
-
-# Input
-HEADERS += parser.h \
-           patternmatcher.h \
-           utils.h \
-           pass_splitunits.h \
-           pass_numbers.h \
-           pass_filesize.h \
-           pass_typehints.h \
-           pass_properties.h \
-           pass_dateperiods.h \
-           pass_datevalues.h \
-           pass_periodnames.h \
-           pass_subqueries.h \
-           pass_comparators.h
-
-SOURCES += main.cpp \
-           patternmatcher.cpp \
-           utils.cpp \
-           parser.cpp \
-           pass_splitunits.cpp \
-           pass_numbers.cpp \
-           pass_filesize.cpp \
-           pass_typehints.cpp \
-           pass_properties.cpp \
-           pass_dateperiods.cpp \
-           pass_datevalues.cpp \
-           pass_periodnames.cpp \
-           pass_subqueries.cpp \
-           pass_comparators.cpp
+
+include(parser.pri)
+
+SOURCES += main.cpp
+
+# Rule tables of the untranslated locale, compiled into the program. They are
+# written as static C++ tables by parser-rulegen, a build of the parser without
+# them, and checked against the translated rules by "make check".
+DEFINES += HAVE_BUILTIN_RULES
+
+rulegen.target = rulegen/parser-rulegen
+rulegen.commands = mkdir -p rulegen && cd rulegen && $$QMAKE_QMAKE $$PWD/rulegen/rulegen.pro && $(MAKE)
+rulegen.depends = $$SOURCES $$HEADERS $$PWD/rulegen/rulegen.pro
+
+BUILTIN_RULES_INPUT = $$PWD/parser.cpp
+
+builtin_rules.input = BUILTIN_RULES_INPUT
+builtin_rules.output = builtinrules.cpp
+builtin_rules.commands = KDE_LANG=en_US rulegen/parser-rulegen --generate-rules ${QMAKE_FILE_OUT}
+builtin_rules.depends = rulegen/parser-rulegen
+builtin_rules.variable_out = SOURCES
+builtin_rules.CONFIG += combine
+builtin_rules.name = builtin_rules
+
+QMAKE_EXTRA_COMPILERS += builtin_rules
+
+check.target = check
+check.commands = KDE_LANG=en_US ./$$TARGET --check-builtin-rules && KDE_LANG=en_US ./$$TARGET --check-matching-modes && KDE_LANG=en_US ./$$TARGET --check-intervals && KDE_LANG=en_US ./$$TARGET --check-sparql-text
+check.depends = $$TARGET
+
+# Compares the SPARQL written by the parser with the one of the Nepomuk query
+# library, on the resources of a running Nepomuk storage
+check_sparql.target = check-sparql
+check_sparql.commands = KDE_LANG=en_US ./$$TARGET --check-sparql
+check_sparql.depends = $$TARGET
+
+# Benchmarks counting the heap allocations of the parser, built as their own
+# program because counting them replaces malloc() for the whole process
+benchmark.target = benchmarks
+benchmark.commands = mkdir -p benchmark && cd benchmark && $$QMAKE_QMAKE $$PWD/benchmark/benchmark.pro && $(MAKE)
+
+QMAKE_EXTRA_TARGETS += rulegen check check_sparql benchmark
@@ -18,43 +18,37 @@
 */
 
 #include "pass_comparators.h"
+#include "token.h"
 
-#include <nepomuk2/property.h>
-
-PassComparators::PassComparators()
-: comparator(Nepomuk2::Query::ComparisonTerm::Equal)
+QVector<quint32> PassComparators::captureTypes()
 {
-}
+    QVector<quint32> rs;
 
-void PassComparators::setComparator(Nepomuk2::Query::ComparisonTerm::Comparator comparator)
-{
-    this->comparator = comparator;
+    // Any comparison, or a literal value
+    rs.append((quint32(Token::AnyType) << Token::ComparisonTypeShift) | Token::literalTypes());
+
+    return rs;
 }
 
-QList<Nepomuk2::Query::Term> PassComparators::run(const QList<Nepomuk2::Query::Term> &match) const
+QVector<Token> PassComparators::run(const QVector<Token> &match,
+                                    Nepomuk2::Query::ComparisonTerm::Comparator comparator) const
 {
-    QList<Nepomuk2::Query::Term> rs;
-    Nepomuk2::Query::ComparisonTerm term;
-
-    if (match.at(0).isComparisonTerm()) {
-        term = match.at(0).toComparisonTerm();
-    } else if (match.at(0).isLiteralTerm()) {
-        // Comparison with a literal term. The property is not given, as it will
+    QVector<Token> rs;
+    Token token = match.at(0);
+
+    if (token.isComparison()) {
+        // Set the comparison operator of the token
+        token.comparator = comparator;
+    } else if (token.isLiteral()) {
+        // Comparison with a literal token. The property is not given, as it will
         // be parsed in a later pass ("age > 5" first matches "> 5" then "age <comparison>")
-        term = Nepomuk2::Query::ComparisonTerm(
-            Nepomuk2::Types::Property(),
-            match.at(0),
-            this->comparator
-        );
+        token.setComparison(QUrl(), comparator);
     } else {
         return rs;
     }
 
-    // Set the comparison operator of the term
-    term.setComparator(comparator);
-
-    // Use this updated term in place of the old one
-    rs.append(term);
+    // Use this updated token in place of the old one
+    rs.append(token);
 
     return rs;
 }
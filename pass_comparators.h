@@ -20,20 +20,18 @@
 #ifndef __PASS_COMPARATORS_H__
 #define __PASS_COMPARATORS_H__
 
-#include <QList>
+#include <QVector>
 #include <nepomuk2/comparisonterm.h>
 
+struct Token;
+
 class PassComparators
 {
     public:
-        PassComparators();
-
-        void setComparator(Nepomuk2::Query::ComparisonTerm::Comparator comparator);
-
-        QList<Nepomuk2::Query::Term> run(const QList<Nepomuk2::Query::Term> &match) const;
+        QVector<Token> run(const QVector<Token> &match,
+                           Nepomuk2::Query::ComparisonTerm::Comparator comparator) const;
 
-    private:
-        Nepomuk2::Query::ComparisonTerm::Comparator comparator;
+        static QVector<quint32> captureTypes();
 };
 
 #endif
\ No newline at end of file
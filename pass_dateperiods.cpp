@@ -18,19 +18,15 @@
 */
 
 #include "pass_dateperiods.h"
+#include "builtinrules.h"
 #include "utils.h"
 
-#include <nepomuk2/literalterm.h>
-#include <nepomuk2/comparisonterm.h>
-#include <nepomuk2/property.h>
 #include <klocalizedstring.h>
 
+#include <QDataStream>
 #include <QtDebug>
 
 PassDatePeriods::PassDatePeriods()
-: period(Year),
-  value_type(Value),
-  value(0)
 {
     registerPeriod(Year,
         i18nc("Space-separated list of words representing a year", "year years"));
@@ -50,10 +46,52 @@ PassDatePeriods::PassDatePeriods()
     periods.insert(nameOfPeriod(DayOfWeek), DayOfWeek);
 }
 
+PassDatePeriods::PassDatePeriods(QDataStream &stream)
+{
+    QHash<QString, qint32> values;
+
+    stream >> values;
+
+    for (QHash<QString, qint32>::const_iterator it = values.constBegin(); it != values.constEnd(); ++it) {
+        // The names designate real periods, VariablePeriod has no field in
+        // the date-times. A corrupt table is rejected as a whole.
+        if (it.value() < 0 || it.value() >= MaxPeriod) {
+            stream.setStatus(QDataStream::ReadCorruptData);
+            periods.clear();
+            return;
+        }
+
+        periods.insert(it.key(), Period(it.value()));
+    }
+}
+
+PassDatePeriods::PassDatePeriods(const BuiltinWords &names)
+{
+    for (int i=0; i<names.count; ++i) {
+        periods.insert(QString::fromUtf8(names.words[i].word), Period(names.words[i].value));
+    }
+}
+
+void PassDatePeriods::save(QDataStream &stream) const
+{
+    QHash<QString, qint32> values;
+
+    for (QHash<QString, Period>::const_iterator it = periods.constBegin(); it != periods.constEnd(); ++it) {
+        values.insert(it.key(), it.value());
+    }
+
+    stream << values;
+}
+
+const QHash<QString, PassDatePeriods::Period> &PassDatePeriods::names() const
+{
+    return periods;
+}
+
 void PassDatePeriods::registerPeriod(Period period, const QString &names)
 {
     Q_FOREACH(const QString &name, names.split(QLatin1Char(' '))) {
-        periods.insert(name, period);
+        periods.insert(Token::normalize(name), period);
     }
 
     // Also insert the plain English name, used to get the period corresponding
@@ -61,13 +99,6 @@ void PassDatePeriods::registerPeriod(Period period, const QString &names)
     periods.insert(nameOfPeriod(period), period);
 }
 
-void PassDatePeriods::setKind(PassDatePeriods::Period period, PassDatePeriods::ValueType value_type, int value)
-{
-    this->period = period;
-    this->value_type = value_type;
-    this->value = value;
-}
-
 QString PassDatePeriods::nameOfPeriod(Period period)
 {
     static const char *period_names[] = {
@@ -89,18 +120,34 @@ QUrl PassDatePeriods::propertyUrl(Period period, bool offset)
     );
 }
 
-QList<Nepomuk2::Query::Term> PassDatePeriods::run(const QList<Nepomuk2::Query::Term> &match) const
+QVector<quint32> PassDatePeriods::captureTypes(Period period, int value)
 {
-    QList<Nepomuk2::Query::Term> rs;
+    QVector<quint32> rs;
+
+    if (period == VariablePeriod) {
+        rs.append(Token::typeBit(Token::String));
+    }
+
+    if (value == 0) {
+        rs.append(Token::typeBit(Token::Integer));
+    }
+
+    return rs;
+}
+
+QVector<Token> PassDatePeriods::run(const QVector<Token> &match,
+                                    Period period,
+                                    ValueType value_type,
+                                    int value) const
+{
+    QVector<Token> rs;
     int value_match_index = 0;
     Period p = period;
     int v = value;
-    int value_position = 0;
-    int value_length = 0;
 
     if (p == VariablePeriod) {
         // Parse the period from match.at(0)
-        QString period_name = termStringValue(match.at(0));
+        QString period_name = tokenStringKey(match.at(0));
 
         if (period_name.isNull() || !periods.contains(period_name)) {
             return rs;
@@ -113,23 +160,17 @@ QList<Nepomuk2::Query::Term> PassDatePeriods::run(const QList<Nepomuk2::Query::T
     if (v == 0 && value_match_index < match.count()) {
         // Parse the value either from match.at(0) (there was no period) or
         // match.at(1)
-        if (!termIntValue(match.at(value_match_index), v)) {
+        if (!tokenIntValue(match.at(value_match_index), v)) {
             return rs;
         }
-
-        value_position = match.at(value_match_index).position();
-        value_length = match.at(value_match_index).length();
     }
 
-    // Create a comparison on the right "property", that will be used in a later
-    // pass to build a real date-time object
-    Nepomuk2::Query::LiteralTerm value_term(value_type == InvertedOffset ? -v : v);
-    value_term.setPosition(value_position, value_length);
-
-    rs.append(Nepomuk2::Query::ComparisonTerm(
-        propertyUrl(p, value_type != Value),
-        value_term,
-        Nepomuk2::Query::ComparisonTerm::Equal
+    // Create a period token, that will be used in a later pass to build a
+    // real date-time object
+    rs.append(Token::fromDatePeriod(
+        p,
+        value_type != Value,
+        value_type == InvertedOffset ? -v : v
     ));
 
     return rs;
@@ -21,11 +21,14 @@
 #define __PASS_DATEPERIODS_H__
 
 #include <QString>
-#include <QList>
+#include <QVector>
 #include <QHash>
 #include <QUrl>
 
-namespace Nepomuk2 { namespace Query { class Term; }}
+struct Token;
+
+class QDataStream;
+struct BuiltinWords;
 
 class PassDatePeriods
 {
@@ -51,10 +54,18 @@ class PassDatePeriods
 
     public:
         PassDatePeriods();
+        explicit PassDatePeriods(QDataStream &stream);
+        explicit PassDatePeriods(const BuiltinWords &names);
+
+        void save(QDataStream &stream) const;
+        const QHash<QString, Period> &names() const;
 
-        void setKind(Period period, ValueType value_type, int value = 0);
+        QVector<Token> run(const QVector<Token> &match,
+                           Period period,
+                           ValueType value_type,
+                           int value) const;
 
-        QList<Nepomuk2::Query::Term> run(const QList<Nepomuk2::Query::Term> &match) const;
+        static QVector<quint32> captureTypes(Period period, int value);
 
         Period periodFromName(const QString &name) const;
         static QString nameOfPeriod(Period period);
@@ -65,10 +76,6 @@ class PassDatePeriods
 
     private:
         QHash<QString, Period> periods;
-
-        Period period;
-        ValueType value_type;
-        int value;
 };
 
 #endif
\ No newline at end of file
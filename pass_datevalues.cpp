@@ -21,24 +21,21 @@
 #include "pass_dateperiods.h"
 #include "utils.h"
 
-#include <nepomuk2/literalterm.h>
-#include <nepomuk2/comparisonterm.h>
-#include <nepomuk2/property.h>
-#include <soprano/literalvalue.h>
-
-PassDateValues::PassDateValues()
-: pm(false)
-{
-}
-
-void PassDateValues::setPm(bool pm)
+QVector<quint32> PassDateValues::captureTypes()
 {
-    this->pm = pm;
+    // Year, month, day, day of week, hour, minute and second. The components
+    // not given by a pattern stay invalid.
+    quint32 types = Token::typeBit(Token::Invalid) |
+                    Token::typeBit(Token::Integer) |
+                    Token::typeBit(Token::DatePeriod) |
+                    Token::typeBit(Token::DatePeriod, true);
+
+    return QVector<quint32>(7, types);
 }
 
-QList<Nepomuk2::Query::Term> PassDateValues::run(const QList<Nepomuk2::Query::Term> &match) const
+QVector<Token> PassDateValues::run(const QVector<Token> &match, bool pm) const
 {
-    QList<Nepomuk2::Query::Term> rs;
+    QVector<Token> rs;
     bool valid_input = true;
     bool progress = false;
 
@@ -61,27 +58,20 @@ QList<Nepomuk2::Query::Term> PassDateValues::run(const QList<Nepomuk2::Query::Te
         PassDatePeriods::Period period = periods[i];
 
         if (i < match.count() && match.at(i).isValid()) {
-            const Nepomuk2::Query::Term &term = match.at(i);
+            const Token &token = match.at(i);
             int value;
 
-            if (!termIntValue(term, value)) {
-                // The term is not a literal integer, but may be a typed comparison
-                // (month or day names)
-                if (!term.isComparisonTerm()) {
+            if (!tokenIntValue(token, value)) {
+                // The token is not a literal integer, but may be a typed period
+                // value (month or day names)
+                if (token.kind != Token::DatePeriod || token.period != period || token.offset) {
                     valid_input = false;
                     break;
                 }
 
-                Nepomuk2::Query::ComparisonTerm comparison = term.toComparisonTerm();
-
-                if (comparison.property().uri() != PassDatePeriods::propertyUrl(period, false)) {
-                    valid_input = false;
-                    break;
-                }
-
-                // Keep the comparison, it is already good. No need to extract
-                // its value only to build a new comparison exactly the same.
-                rs.append(comparison);
+                // Keep the period, it is already good. No need to extract
+                // its value only to build a new token exactly the same.
+                rs.append(token);
                 continue;
             }
 
@@ -94,19 +84,11 @@ QList<Nepomuk2::Query::Term> PassDateValues::run(const QList<Nepomuk2::Query::Te
                 value += 12;
             }
 
-            // Build a comparison of the right type
-            Nepomuk2::Query::LiteralTerm value_term(value);
+            // Build a period token of the right type
             progress = true;
 
-            value_term.setPosition(term);
-
-            rs.append(Nepomuk2::Query::ComparisonTerm(
-                PassDatePeriods::propertyUrl(period, false),
-                value_term,
-                Nepomuk2::Query::ComparisonTerm::Equal
-            ));
-
-            rs.last().setPosition(term);
+            rs.append(Token::fromDatePeriod(period, false, value));
+            rs.last().setPosition(token);
         }
     }
 
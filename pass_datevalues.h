@@ -20,21 +20,16 @@
 #ifndef __PASS_DATEVALUES_H__
 #define __PASS_DATEVALUES_H__
 
-#include <QList>
+#include <QVector>
 
-namespace Nepomuk2 { namespace Query { class Term; }}
+struct Token;
 
 class PassDateValues
 {
     public:
-        PassDateValues();
+        QVector<Token> run(const QVector<Token> &match, bool pm) const;
 
-        void setPm(bool pm);
-
-        QList<Nepomuk2::Query::Term> run(const QList<Nepomuk2::Query::Term> &match) const;
-
-    private:
-        bool pm;
+        static QVector<quint32> captureTypes();
 };
 
 #endif
\ No newline at end of file
@@ -18,14 +18,13 @@
 */
 
 #include "pass_filesize.h"
+#include "builtinrules.h"
 #include "utils.h"
 
-#include <nepomuk2/literalterm.h>
-#include <nepomuk2/comparisonterm.h>
-#include <nepomuk2/property.h>
-#include <soprano/literalvalue.h>
 #include <klocalizedstring.h>
 
+#include <QDataStream>
+
 PassFileSize::PassFileSize()
 {
     // File size units
@@ -40,35 +39,66 @@ PassFileSize::PassFileSize()
     registerUnits(1LL << 40, i18nc("Lower-case units corresponding to a tebibyte", "tib t tebibyte tebibytes"));
 }
 
+PassFileSize::PassFileSize(QDataStream &stream)
+{
+    stream >> multipliers;
+}
+
+PassFileSize::PassFileSize(const BuiltinWords &units)
+{
+    for (int i=0; i<units.count; ++i) {
+        multipliers.insert(QString::fromUtf8(units.words[i].word), units.words[i].value);
+    }
+}
+
+void PassFileSize::save(QDataStream &stream) const
+{
+    stream << multipliers;
+}
+
+const QHash<QString, long long int> &PassFileSize::units() const
+{
+    return multipliers;
+}
+
 void PassFileSize::registerUnits(long long int multiplier, const QString &units)
 {
     Q_FOREACH(const QString &unit, units.split(QLatin1Char(' '))) {
-        multipliers.insert(unit, multiplier);
+        multipliers.insert(Token::normalize(unit), multiplier);
     }
 }
 
-QList<Nepomuk2::Query::Term> PassFileSize::run(const QList<Nepomuk2::Query::Term> &match) const
+QVector<quint32> PassFileSize::captureTypes()
+{
+    QVector<quint32> rs;
+
+    // Number and unit
+    rs.append(Token::literalTypes());
+    rs.append(Token::literalTypes());
+
+    return rs;
+}
+
+QVector<Token> PassFileSize::run(const QVector<Token> &match) const
 {
-    QList<Nepomuk2::Query::Term> rs;
+    QVector<Token> rs;
 
-    if (!match.at(0).isLiteralTerm() || !match.at(1).isLiteralTerm()) {
+    if (!match.at(0).isLiteral() || !match.at(1).isLiteral()) {
         return rs;
     }
 
     // Unit
-    QString unit = match.at(1).toLiteralTerm().value().toString().toLower();
+    QString unit = match.at(1).toKey();
 
     if (multipliers.contains(unit)) {
         long long int multiplier = multipliers.value(unit);
-        Nepomuk2::Query::LiteralTerm term = match.at(0).toLiteralTerm();
+        const Token &value = match.at(0);
 
-        if (term.value().isDouble()) {
-            term.setValue(term.value().toDouble() * double(multiplier));
+        if (value.kind == Token::Double) {
+            rs.append(Token::fromDouble(value.real * double(multiplier)));
         } else {
-            term.setValue(term.value().toInt64() * multiplier);
+            rs.append(Token::fromInteger(value.toInteger() * multiplier));
         }
-
-        rs.append(term);
     }
 
     return rs;
@@ -21,17 +21,27 @@
 #define __PASS_FILESIZE_H__
 
 #include <QString>
-#include <QList>
+#include <QVector>
 #include <QHash>
 
-namespace Nepomuk2 { namespace Query { class Term; }}
+struct Token;
+
+class QDataStream;
+struct BuiltinWords;
 
 class PassFileSize
 {
     public:
         PassFileSize();
+        explicit PassFileSize(QDataStream &stream);
+        explicit PassFileSize(const BuiltinWords &units);
+
+        void save(QDataStream &stream) const;
+        const QHash<QString, long long int> &units() const;
+
+        QVector<Token> run(const QVector<Token> &match) const;
 
-        QList<Nepomuk2::Query::Term> run(const QList<Nepomuk2::Query::Term> &match) const;
+        static QVector<quint32> captureTypes();
 
     private:
         void registerUnits(long long int multiplier, const QString &units);
@@ -18,12 +18,12 @@
 */
 
 #include "pass_numbers.h"
+#include "builtinrules.h"
 #include "utils.h"
 
-#include <nepomuk2/literalterm.h>
-#include <soprano/literalvalue.h>
 #include <klocalizedstring.h>
 
+#include <QDataStream>
 #include <QtDebug>
 
 PassNumbers::PassNumbers()
@@ -41,29 +41,61 @@ PassNumbers::PassNumbers()
     registerNames(10, i18nc("Space-separated list of words meaning 10", "ten tenth"));
 }
 
+PassNumbers::PassNumbers(QDataStream &stream)
+{
+    stream >> number_names;
+}
+
+PassNumbers::PassNumbers(const BuiltinWords &names)
+{
+    for (int i=0; i<names.count; ++i) {
+        number_names.insert(QString::fromUtf8(names.words[i].word), names.words[i].value);
+    }
+}
+
+void PassNumbers::save(QDataStream &stream) const
+{
+    stream << number_names;
+}
+
+const QHash<QString, long long int> &PassNumbers::names() const
+{
+    return number_names;
+}
+
 void PassNumbers::registerNames(long long int number, const QString &names)
 {
     Q_FOREACH(const QString &name, names.split(QLatin1Char(' '))) {
-        number_names.insert(name, number);
+        number_names.insert(Token::normalize(name), number);
     }
 }
 
-QList<Nepomuk2::Query::Term> PassNumbers::run(const QList<Nepomuk2::Query::Term> &match) const
+QVector<quint32> PassNumbers::captureTypes()
+{
+    QVector<quint32> rs;
+
+    rs.append(Token::typeBit(Token::String));
+
+    return rs;
+}
+
+QVector<Token> PassNumbers::run(const QVector<Token> &match) const
 {
-    QList<Nepomuk2::Query::Term> rs;
+    QVector<Token> rs;
 
     // Single integer number
-    QString value = termStringValue(match.at(0)).toLower();
+    QString key = tokenStringKey(match.at(0));
 
-    if (value.isNull()) {
+    if (key.isNull()) {
         return rs;
     }
 
     // Named integer
-    if (number_names.contains(value)) {
-        rs.append(Nepomuk2::Query::LiteralTerm(number_names.value(value)));
+    if (number_names.contains(key)) {
+        rs.append(Token::fromInteger(number_names.value(key)));
     } else {
         // Integer or double
+        const QString &value = match.at(0).string;
         bool is_integer = false;
         bool is_double = false;
         long long int as_integer = value.toLongLong(&is_integer);
@@ -71,9 +103,9 @@ QList<Nepomuk2::Query::Term> PassNumbers::run(const QList<Nepomuk2::Query::Term>
 
         // Prefer integers over doubles
         if (is_integer) {
-            rs.append(Nepomuk2::Query::LiteralTerm(as_integer));
+            rs.append(Token::fromInteger(as_integer));
         } else if (is_double) {
-            rs.append(Nepomuk2::Query::LiteralTerm(as_double));
+            rs.append(Token::fromDouble(as_double));
         }
     }
 
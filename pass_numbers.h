@@ -20,17 +20,27 @@
 #ifndef __PASS_NUMBERS_H__
 #define __PASS_NUMBERS_H__
 
-#include <QList>
+#include <QVector>
 #include <QHash>
 
-namespace Nepomuk2 { namespace Query { class Term; }}
+struct Token;
+
+class QDataStream;
+struct BuiltinWords;
 
 class PassNumbers
 {
     public:
         PassNumbers();
+        explicit PassNumbers(QDataStream &stream);
+        explicit PassNumbers(const BuiltinWords &names);
+
+        void save(QDataStream &stream) const;
+        const QHash<QString, long long int> &names() const;
+
+        QVector<Token> run(const QVector<Token> &match) const;
 
-        QList<Nepomuk2::Query::Term> run(const QList<Nepomuk2::Query::Term> &match) const;
+        static QVector<quint32> captureTypes();
 
     private:
         void registerNames(long long int number, const QString &names);
@@ -18,14 +18,14 @@
 */
 
 #include "pass_periodnames.h"
+#include "builtinrules.h"
 #include "pass_dateperiods.h"
 #include "utils.h"
 
-#include <nepomuk2/comparisonterm.h>
-#include <nepomuk2/literalterm.h>
-#include <nepomuk2/property.h>
 #include <klocalizedstring.h>
 
+#include <QDataStream>
+
 PassPeriodNames::PassPeriodNames()
 {
     registerNames(day_names, i18nc(
@@ -38,39 +38,66 @@ PassPeriodNames::PassPeriodNames()
     ));
 }
 
+PassPeriodNames::PassPeriodNames(QDataStream &stream)
+{
+    stream >> day_names >> month_names;
+}
+
+static void insertNames(QHash<QString, int> &table, const BuiltinWords &names)
+{
+    for (int i=0; i<names.count; ++i) {
+        table.insert(QString::fromUtf8(names.words[i].word), int(names.words[i].value));
+    }
+}
+
+PassPeriodNames::PassPeriodNames(const BuiltinWords &days, const BuiltinWords &months)
+{
+    insertNames(day_names, days);
+    insertNames(month_names, months);
+}
+
+void PassPeriodNames::save(QDataStream &stream) const
+{
+    stream << day_names << month_names;
+}
+
+const QHash<QString, int> &PassPeriodNames::dayNames() const
+{
+    return day_names;
+}
+
+const QHash<QString, int> &PassPeriodNames::monthNames() const
+{
+    return month_names;
+}
+
 void PassPeriodNames::registerNames(QHash<QString, int> &table, const QString &names)
 {
     QStringList list = names.split(QLatin1Char(' '));
 
     for (int i=0; i<list.count(); ++i) {
-        table.insert(list.at(i), i + 1);    // Count from 1 as calendars do this
+        table.insert(Token::normalize(list.at(i)), i + 1);    // Count from 1 as calendars do this
     }
 }
 
-QList<Nepomuk2::Query::Term> PassPeriodNames::run(const QList<Nepomuk2::Query::Term> &match) const
+QVector<quint32> PassPeriodNames::captureTypes()
 {
-    QList<Nepomuk2::Query::Term> rs;
-    QString name = termStringValue(match.at(0)).toLower();
+    QVector<quint32> rs;
 
-    Nepomuk2::Query::LiteralTerm value_term;
-    PassDatePeriods::Period period;
+    rs.append(Token::typeBit(Token::String));
 
-    if (day_names.contains(name)) {
-        period = PassDatePeriods::DayOfWeek;
-        value_term.setValue(day_names.value(name));
-    } else if (month_names.contains(name)) {
-        period = PassDatePeriods::Month;
-        value_term.setValue(month_names.value(name));
-    }
+    return rs;
+}
 
-    if (value_term.isValid()) {
-        value_term.setPosition(match.at(0));
+QVector<Token> PassPeriodNames::run(const QVector<Token> &match) const
+{
+    QVector<Token> rs;
+    QString name = tokenStringKey(match.at(0));
 
-        rs.append(Nepomuk2::Query::ComparisonTerm(
-            PassDatePeriods::propertyUrl(period, false),
-            value_term,
-            Nepomuk2::Query::ComparisonTerm::Equal
-        ));
+    if (day_names.contains(name)) {
+        rs.append(Token::fromDatePeriod(PassDatePeriods::DayOfWeek, false, day_names.value(name)));
+    } else if (month_names.contains(name)) {
+        rs.append(Token::fromDatePeriod(PassDatePeriods::Month, false, month_names.value(name)));
     }
 
     return rs;
@@ -21,17 +21,28 @@
 #define __PASS_PERIODNAMES_H__
 
 #include <QString>
-#include <QList>
+#include <QVector>
 #include <QHash>
 
-namespace Nepomuk2 { namespace Query { class Term; }}
+struct Token;
+
+class QDataStream;
+struct BuiltinWords;
 
 class PassPeriodNames
 {
     public:
         PassPeriodNames();
+        explicit PassPeriodNames(QDataStream &stream);
+        PassPeriodNames(const BuiltinWords &days, const BuiltinWords &months);
+
+        void save(QDataStream &stream) const;
+        const QHash<QString, int> &dayNames() const;
+        const QHash<QString, int> &monthNames() const;
+
+        QVector<Token> run(const QVector<Token> &match) const;
 
-        QList<Nepomuk2::Query::Term> run(const QList<Nepomuk2::Query::Term> &match) const;
+        static QVector<quint32> captureTypes();
 
     private:
         void registerNames(QHash<QString, int> &table, const QString &names);
@@ -20,133 +20,181 @@
 #include "pass_properties.h"
 #include "utils.h"
 
-#include <nepomuk2/literalterm.h>
+#include "tagcache.h"
+#include "nepomuktagsource.h"
+
 #include <nepomuk2/comparisonterm.h>
-#include <nepomuk2/property.h>
-#include <nepomuk2/resourcemanager.h>
-#include <nepomuk2/resourceterm.h>
-#include <soprano/nao.h>
-#include <soprano/rdfs.h>
-#include <soprano/model.h>
-#include <soprano/queryresultiterator.h>
+
+#include <QCoreApplication>
+#include <QMutex>
+#include <QMutexLocker>
+
+// The Nepomuk model is only connected to when tags are read and no other
+// source was given to the pass
+struct PassProperties::TagSources
+{
+    TagSources()
+    : has_source(0)
+    {}
+
+    QMutex mutex;
+    QAtomicInt has_source;
+    QSharedPointer<NepomukTagSource> nepomuk_tags;
+};
 
 PassProperties::PassProperties()
-: cached_tags_filled(false)
+: tag_sources(new TagSources),
+  tag_cache(new TagCache(0))
 {
 }
 
-void PassProperties::setProperty(const QUrl &property, Types range)
+void PassProperties::setTagSource(TagSource *source)
 {
-    this->property = property;
-    this->range = range;
+    QMutexLocker locker(&tag_sources->mutex);
+
+    if (!source) {
+        source = tag_sources->nepomuk_tags.data();
+    }
+
+    if (source) {
+        tag_cache->setSource(source);
+    }
+
+    tag_sources->has_source.fetchAndStoreOrdered(source ? 1 : 0);
 }
 
-const QHash<QString, QUrl> &PassProperties::tags() const
+TagCache *PassProperties::tags() const
 {
-    if (!cached_tags_filled) {
-        const_cast<PassProperties *>(this)->fillTagsCache();
+    if (int(tag_sources->has_source)) {
+        return tag_cache.data();
+    }
+
+    QMutexLocker locker(&tag_sources->mutex);
+
+    if (!int(tag_sources->has_source)) {
+        NepomukTagSource *source = new NepomukTagSource;
+
+        // The changes of the tags are notified in the main thread, not in
+        // the parsing thread that happens to read the first tag
+        if (QCoreApplication::instance()) {
+            source->moveToThread(QCoreApplication::instance()->thread());
+        }
+
+        tag_sources->nepomuk_tags = QSharedPointer<NepomukTagSource>(source);
+        tag_cache->setSource(source);
+        tag_sources->has_source.fetchAndStoreOrdered(1);
     }
 
-    return cached_tags;
+    return tag_cache.data();
 }
 
-void PassProperties::fillTagsCache()
+int PassProperties::tagGeneration() const
 {
-    cached_tags_filled = true;
-
-    // Get the tags URIs and their label in one SPARQL query
-    QString query = QString::fromLatin1("select ?tag ?label where { "
-                                        "?tag a %1 . "
-                                        "?tag %2 ?label . "
-                                        "}")
-                    .arg(Soprano::Node::resourceToN3(Soprano::Vocabulary::NAO::Tag()),
-                         Soprano::Node::resourceToN3(Soprano::Vocabulary::RDFS::label()));
-
-    Soprano::QueryResultIterator it =
-        Nepomuk2::ResourceManager::instance()->mainModel()->executeQuery(query, Soprano::Query::QueryLanguageSparql);
-
-    while(it.next()) {
-        cached_tags.insert(
-            it["label"].toString(),
-            QUrl(it["tag"].toString())
-        );
+    return tag_cache->generation();
+}
+
+QStringList PassProperties::tagsWithPrefix(const QString &prefix, int max_count) const
+{
+    QStringList rs;
+    QList<QPair<QString, QUrl> > found = tags()->tagsWithPrefix(prefix, max_count);
+
+    for (int i=0; i<found.count(); ++i) {
+        rs.append(found.at(i).first);
     }
+
+    return rs;
 }
 
-Nepomuk2::Query::Term PassProperties::convertToRange(const Nepomuk2::Query::LiteralTerm &term) const
+Token PassProperties::convertToRange(const Token &token, Types range) const
 {
-    Soprano::LiteralValue value = term.value();
+    Token rs;
 
     switch (range)
     {
         case Integer:
-            if (value.isInt() || value.isInt64()) {
-                return term;
+            if (token.kind == Token::Integer) {
+                rs = token;
             }
             break;
 
         case IntegerOrDouble:
-            if (value.isInt() || value.isInt64() || value.isDouble()) {
-                return term;
+            if (token.kind == Token::Integer || token.kind == Token::Double) {
+                rs = token;
             }
             break;
 
         case String:
-            if (value.isString()) {
-                return term;
+            if (token.kind == Token::String) {
+                rs = token;
             }
             break;
 
         case DateTime:
-            if (value.isDateTime()) {
-                return term;
+            if (token.kind == Token::DateTime) {
+                rs = token;
             }
             break;
 
         case Tag:
-            if (value.isString() && tags().contains(value.toString())) {
-                Nepomuk2::Query::ResourceTerm rs(cached_tags.value(value.toString()));
-                rs.setPosition(term);
-
-                return rs;
+            if (token.kind == Token::String) {
+                TagCache *cache = tags();
+                QUrl tag = cache->tag(token.string);
+
+                if (tag.isEmpty()) {
+                    // "tagged as Holidays" also finds the tag "holidays"
+                    tag = cache->tag(token.string, Qt::CaseInsensitive);
+                }
+
+                if (!tag.isEmpty()) {
+                    rs = Token::fromResource(tag);
+                    rs.setPosition(token);
+                }
             }
             break;
     }
 
-    return Nepomuk2::Query::Term();
+    return rs;
+}
+
+QVector<quint32> PassProperties::captureTypes()
+{
+    QVector<quint32> rs;
+
+    // Literal value, or comparison with a literal value
+    rs.append(Token::literalTypes() | Token::literalTypes(true));
+
+    return rs;
 }
 
-QList<Nepomuk2::Query::Term> PassProperties::run(const QList<Nepomuk2::Query::Term> &match) const
+QVector<Token> PassProperties::run(const QVector<Token> &match, const QUrl &property, Types range) const
 {
-    QList<Nepomuk2::Query::Term> rs;
-    Nepomuk2::Query::Term term = match.at(0);
-    Nepomuk2::Query::Term subterm;
+    QVector<Token> rs;
+    const Token &token = match.at(0);
+    Token value;
     Nepomuk2::Query::ComparisonTerm::Comparator comparator;
 
-    if (term.isComparisonTerm()) {
-        Nepomuk2::Query::ComparisonTerm &comparison = term.toComparisonTerm();
+    if (token.isComparison()) {
+        Token literal = token;
+        literal.comparison = false;
 
-        if (comparison.subTerm().isLiteralTerm()) {
-            subterm = convertToRange(comparison.subTerm().toLiteralTerm());
-            comparator = comparison.comparator();
+        if (literal.isLiteral()) {
+            value = convertToRange(literal, range);
+            comparator = token.comparator;
         }
-    } else if (term.isLiteralTerm()) {
+    } else if (token.isLiteral()) {
         // Property followed by a value, the comparator is "contains" for strings
         // and the equality for everything else
-        subterm = convertToRange(term.toLiteralTerm());
+        value = convertToRange(token, range);
         comparator = (
-            (subterm.isLiteralTerm() && subterm.toLiteralTerm().value().isString()) ?
+            value.kind == Token::String ?
             Nepomuk2::Query::ComparisonTerm::Contains :
             Nepomuk2::Query::ComparisonTerm::Equal
         );
     }
 
-    if (subterm.isValid()) {
-        rs.append(Nepomuk2::Query::ComparisonTerm(
-            property,
-            subterm,
-            comparator
-        ));
+    if (value.isValid()) {
+        value.setComparison(property, comparator);
+        rs.append(value);
     }
 
     return rs;
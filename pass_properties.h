@@ -20,10 +20,14 @@
 #ifndef __PASS_PROPERTIES_H__
 #define __PASS_PROPERTIES_H__
 
-#include <QList>
+#include <QVector>
+#include <QStringList>
 #include <QUrl>
+#include <QSharedPointer>
 
-#include <nepomuk2/literalterm.h>
+struct Token;
+class TagSource;
+class TagCache;
 
 class PassProperties
 {
@@ -38,22 +42,24 @@ class PassProperties
 
         PassProperties();
 
-        void setProperty(const QUrl &property, Types range);
+        void setTagSource(TagSource *source);
+        QStringList tagsWithPrefix(const QString &prefix, int max_count) const;
+        int tagGeneration() const;
 
-        const QHash<QString, QUrl> &tags() const;
-        QList<Nepomuk2::Query::Term> run(const QList<Nepomuk2::Query::Term> &match) const;
+        QVector<Token> run(const QVector<Token> &match, const QUrl &property, Types range) const;
 
-    private:
-        Nepomuk2::Query::Term convertToRange(const Nepomuk2::Query::LiteralTerm &term) const;
-        void fillTagsCache();
+        static QVector<quint32> captureTypes();
 
     private:
-        QUrl property;
-        Types range;
+        struct TagSources;
+
+        Token convertToRange(const Token &token, Types range) const;
+        TagCache *tags() const;
 
-        // Cache for tags
-        QHash<QString, QUrl> cached_tags;
-        bool cached_tags_filled;
+    private:
+        // Shared by the copies of the pass
+        QSharedPointer<TagSources> tag_sources;
+        QSharedPointer<TagCache> tag_cache;
 };
 
 #endif
\ No newline at end of file
@@ -18,75 +18,115 @@
 */
 
 #include "pass_splitunits.h"
+#include "builtinrules.h"
 #include "utils.h"
 
-#include <nepomuk2/literalterm.h>
-#include <soprano/literalvalue.h>
 #include <klocalizedstring.h>
 
+#include <QDataStream>
 #include <QtDebug>
 
 PassSplitUnits::PassSplitUnits()
-: known_units(
-    QSet<QString>::fromList(
-        i18nc(
-            "List of lowercase prefixes or suffix that need to be split from values",
-            "k m g b kb mb gb tb kib mib gib tib h am pm th rd nd st"
-        ).split(QLatin1Char(' '))
-    )
-  )
 {
+    QStringList units = i18nc(
+        "List of lowercase prefixes or suffix that need to be split from values",
+        "k m g b kb mb gb tb kib mib gib tib h am pm th rd nd st"
+    ).split(QLatin1Char(' '));
+
+    Q_FOREACH(const QString &unit, units) {
+        known_units.insert(Token::normalize(unit));
+    }
+}
+
+PassSplitUnits::PassSplitUnits(QDataStream &stream)
+{
+    stream >> known_units;
+}
+
+PassSplitUnits::PassSplitUnits(const BuiltinWords &units)
+{
+    for (int i=0; i<units.count; ++i) {
+        known_units.insert(QString::fromUtf8(units.words[i].word));
+    }
 }
 
-QList<Nepomuk2::Query::Term> PassSplitUnits::run(const QList<Nepomuk2::Query::Term> &match) const
+void PassSplitUnits::save(QDataStream &stream) const
 {
-    QList<Nepomuk2::Query::Term> rs;
-    Nepomuk2::Query::LiteralTerm value_term;
-    Nepomuk2::Query::LiteralTerm unit_term;
+    stream << known_units;
+}
 
-    QString value = termStringValue(match.at(0));
-    int value_position = match.at(0).position();
+const QSet<QString> &PassSplitUnits::units() const
+{
+    return known_units;
+}
+
+QVector<quint32> PassSplitUnits::captureTypes()
+{
+    QVector<quint32> rs;
+
+    rs.append(Token::typeBit(Token::String));
+
+    return rs;
+}
+
+QVector<Token> PassSplitUnits::run(const QVector<Token> &match) const
+{
+    QVector<Token> rs;
+    Token value_token;
+    Token unit_token;
+
+    QString value = tokenStringValue(match.at(0));
+    int value_position = match.at(0).position;
 
     if (value.isNull()) {
         return rs;
     }
 
-    // Possible prefix
-    QString prefix;
+    // Possible prefix. The letters are only normalized when they are
+    // followed by something else.
+    int prefix_size = 0;
 
-    for (int i=0; i<value.size() && value.at(i).isLetter(); ++i) {
-        prefix.append(value.at(i).toLower());
+    while (prefix_size < value.size() && value.at(prefix_size).isLetter()) {
+        ++prefix_size;
     }
 
-    if (prefix.size() < value.size() && known_units.contains(prefix)) {
-        unit_term.setValue(prefix);
-        unit_term.setPosition(value_position, prefix.size());
+    if (prefix_size > 0 && prefix_size < value.size()) {
+        QString prefix = Token::normalize(value.left(prefix_size));
 
-        value = value.mid(prefix.size());
-        value_position += prefix.size();
+        if (known_units.contains(prefix)) {
+            unit_token = Token::fromString(prefix);
+            unit_token.setPosition(value_position, prefix_size);
+
+            value = value.mid(prefix_size);
+            value_position += prefix_size;
+        }
     }
 
     // Possible postfix
-    QString postfix;
+    int postfix_size = 0;
 
-    for (int i=value.size()-1; i>=0 && value.at(i).isLetter(); --i) {
-        postfix.prepend(value.at(i).toLower());
+    while (postfix_size < value.size() && value.at(value.size() - postfix_size - 1).isLetter()) {
+        ++postfix_size;
     }
 
-    if (postfix.size() < value.size() && known_units.contains(postfix)) {
-        value.resize(value.size() - postfix.size());
+    if (postfix_size > 0 && postfix_size < value.size()) {
+        QString postfix = Token::normalize(value.right(postfix_size));
+
+        if (known_units.contains(postfix)) {
+            value.resize(value.size() - postfix_size);
 
-        unit_term.setValue(postfix);
-        unit_term.setPosition(value_position + value.size(), postfix.size());
+            unit_token = Token::fromString(postfix);
+            unit_token.setPosition(value_position + value.size(), postfix_size);
+        }
     }
 
     // Value
-    value_term.setValue(value);
-    value_term.setPosition(value_position, value.size());
+    value_token = Token::fromString(value);
+    value_token.setPosition(value_position, value.size());
 
-    if (unit_term.isValid()) {
-        rs.append(value_term);
-        rs.append(unit_term);
+    if (unit_token.isValid()) {
+        rs.append(value_token);
+        rs.append(unit_token);
     }
 
     return rs;
@@ -21,17 +21,27 @@
 #define __PASS_SPLITUNITS_H__
 
 #include <QString>
-#include <QList>
+#include <QVector>
 #include <QSet>
 
-namespace Nepomuk2 { namespace Query { class Term; }}
+struct Token;
+
+class QDataStream;
+struct BuiltinWords;
 
 class PassSplitUnits
 {
     public:
         PassSplitUnits();
+        explicit PassSplitUnits(QDataStream &stream);
+        explicit PassSplitUnits(const BuiltinWords &units);
+
+        void save(QDataStream &stream) const;
+        const QSet<QString> &units() const;
+
+        QVector<Token> run(const QVector<Token> &match) const;
 
-        QList<Nepomuk2::Query::Term> run(const QList<Nepomuk2::Query::Term> &match) const;
+        static QVector<quint32> captureTypes();
 
     private:
         QSet<QString> known_units;
@@ -20,27 +20,16 @@
 #include "pass_subqueries.h"
 #include "utils.h"
 
-#include <nepomuk2/literalterm.h>
 #include <nepomuk2/comparisonterm.h>
-#include <nepomuk2/property.h>
 
-void PassSubqueries::setProperty(const QUrl &property)
+QVector<Token> PassSubqueries::run(const QVector<Token> &match, const QUrl &property) const
 {
-    this->property = property;
-}
-
-QList<Nepomuk2::Query::Term> PassSubqueries::run(const QList<Nepomuk2::Query::Term> &match) const
-{
-    QList<Nepomuk2::Query::Term> rs;
-
-    // Fuse the matched terms (... in "related to ... ,") into a subquery
-    int end_index;
+    QVector<Token> rs;
 
-    rs.append(Nepomuk2::Query::ComparisonTerm(
-        property,
-        fuseTerms(match, 0, end_index),
-        Nepomuk2::Query::ComparisonTerm::Equal
-    ));
+    // The matched tokens (... in "related to ... ,") are fused into a
+    // subquery with the rest of the query
+    rs.append(Token::fromSubquery(match));
+    rs.last().setComparison(property, Nepomuk2::Query::ComparisonTerm::Equal);
 
     return rs;
 }
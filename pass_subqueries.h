@@ -20,20 +20,15 @@
 #ifndef __PASS_SUBQUERIES_H__
 #define __PASS_SUBQUERIES_H__
 
-#include <QList>
+#include <QVector>
 #include <QUrl>
 
-namespace Nepomuk2 { namespace Query { class Term; }}
+struct Token;
 
 class PassSubqueries
 {
     public:
-        void setProperty(const QUrl &property);
-
-        QList<Nepomuk2::Query::Term> run(const QList<Nepomuk2::Query::Term> &match) const;
-
-    private:
-        QUrl property;
+        QVector<Token> run(const QVector<Token> &match, const QUrl &property) const;
 };
 
 #endif
\ No newline at end of file
@@ -18,13 +18,13 @@
 */
 
 #include "pass_typehints.h"
+#include "builtinrules.h"
 #include "utils.h"
 
-#include <nepomuk2/literalterm.h>
-#include <nepomuk2/resourcetypeterm.h>
-#include <soprano/literalvalue.h>
 #include <klocalizedstring.h>
 
+#include <QDataStream>
+
 #include <nepomuk2/nfo.h>
 #include <nepomuk2/nmo.h>
 #include <nepomuk2/nco.h>
@@ -50,26 +50,55 @@ PassTypeHints::PassTypeHints()
         i18nc("List of words representing an event", "event events"));
 }
 
+PassTypeHints::PassTypeHints(QDataStream &stream)
+{
+    stream >> type_hints;
+}
+
+PassTypeHints::PassTypeHints(const BuiltinWords &hints, const char *const *types)
+{
+    for (int i=0; i<hints.count; ++i) {
+        type_hints.insert(QString::fromUtf8(hints.words[i].word), QUrl::fromEncoded(types[hints.words[i].value]));
+    }
+}
+
+void PassTypeHints::save(QDataStream &stream) const
+{
+    stream << type_hints;
+}
+
+const QHash<QString, QUrl> &PassTypeHints::hints() const
+{
+    return type_hints;
+}
+
 void PassTypeHints::registerHints(const QUrl &type, const QString &hints)
 {
     Q_FOREACH(const QString &hint, hints.split(QLatin1Char(' '))) {
-        type_hints.insert(hint, type);
+        type_hints.insert(Token::normalize(hint), type);
     }
 }
 
-QList<Nepomuk2::Query::Term> PassTypeHints::run(const QList<Nepomuk2::Query::Term> &match) const
+QVector<quint32> PassTypeHints::captureTypes()
+{
+    QVector<quint32> rs;
+
+    rs.append(Token::typeBit(Token::String));
+
+    return rs;
+}
+
+QVector<Token> PassTypeHints::run(const QVector<Token> &match) const
 {
-    QList<Nepomuk2::Query::Term> rs;
-    QString value = termStringValue(match.at(0));
+    QVector<Token> rs;
+    QString value = tokenStringKey(match.at(0));
 
     if (value.isNull()) {
         return rs;
     }
 
     if (type_hints.contains(value)) {
-        rs.append(Nepomuk2::Query::ResourceTypeTerm(
-            Nepomuk2::Types::Class(type_hints.value(value))
-        ));
+        rs.append(Token::fromResourceType(type_hints.value(value)));
     }
 
     return rs;
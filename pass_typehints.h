@@ -21,18 +21,28 @@
 #define __PASS_TYPEHINTS_H__
 
 #include <QString>
-#include <QList>
+#include <QVector>
 #include <QHash>
 #include <QUrl>
 
-namespace Nepomuk2 { namespace Query { class Term; }}
+struct Token;
+
+class QDataStream;
+struct BuiltinWords;
 
 class PassTypeHints
 {
     public:
         PassTypeHints();
+        explicit PassTypeHints(QDataStream &stream);
+        PassTypeHints(const BuiltinWords &hints, const char *const *types);
+
+        void save(QDataStream &stream) const;
+        const QHash<QString, QUrl> &hints() const;
+
+        QVector<Token> run(const QVector<Token> &match) const;
 
-        QList<Nepomuk2::Query::Term> run(const QList<Nepomuk2::Query::Term> &match) const;
+        static QVector<quint32> captureTypes();
 
     private:
         void registerHints(const QUrl &type, const QString &hints);
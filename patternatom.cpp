@@ -0,0 +1,145 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "patternatom.h"
+#include "token.h"
+
+PatternAtom::PatternAtom()
+: atom_kind(Literal),
+  capture_index(-1)
+{
+}
+
+PatternAtom::PatternAtom(const QString &pattern)
+: atom_pattern(pattern),
+  atom_kind(RegularExpression),
+  capture_index(-1)
+{
+    QString word;
+
+    if (pattern.startsWith(QLatin1Char('%'))) {
+        atom_kind = Placeholder;
+        capture_index = pattern.mid(1).toInt() - 1;
+    } else if (pattern == QLatin1String("...")) {
+        atom_kind = CatchAll;
+    } else if (unescapeWord(pattern, word)) {
+        atom_kind = Literal;
+        literal = Token::normalize(word);
+    } else if (pattern.size() > 2 &&
+               pattern.startsWith(QLatin1Char('(')) &&
+               pattern.endsWith(QLatin1Char(')')))
+    {
+        // "(a|b|c)" where a, b and c are plain words
+        atom_kind = Alternation;
+
+        Q_FOREACH(const QString &alternative, pattern.mid(1, pattern.size() - 2).split(QLatin1Char('|'))) {
+            if (alternative.isEmpty() || !unescapeWord(alternative, word)) {
+                atom_kind = RegularExpression;
+                alternatives.clear();
+                break;
+            }
+
+            alternatives.insert(Token::normalize(word));
+        }
+    }
+
+    if (atom_kind == RegularExpression) {
+        // Genuine regular expression, compiled only once
+        regexp = QRegExp(pattern, Qt::CaseInsensitive, QRegExp::RegExp2);
+        regexp.isValid();   // Builds the matching engine now, not in a parsing thread
+    }
+}
+
+bool PatternAtom::unescapeWord(const QString &pattern, QString &word)
+{
+    static const QString special_chars = QLatin1String("^$.[]()|*+?{}");
+
+    word.clear();
+
+    for (int i=0; i<pattern.size(); ++i) {
+        QChar c = pattern.at(i);
+
+        if (c == QLatin1Char('\\')) {
+            // "\>" is a plain ">", but "\d" or "\b" have a special meaning
+            if (i + 1 == pattern.size() || pattern.at(i + 1).isLetterOrNumber()) {
+                return false;
+            }
+
+            c = pattern.at(++i);
+        } else if (special_chars.contains(c)) {
+            return false;
+        }
+
+        word.append(c);
+    }
+
+    return true;
+}
+
+PatternAtom::Kind PatternAtom::kind() const
+{
+    return atom_kind;
+}
+
+int PatternAtom::captureIndex() const
+{
+    return capture_index;
+}
+
+const QString &PatternAtom::pattern() const
+{
+    return atom_pattern;
+}
+
+QStringList PatternAtom::words() const
+{
+    // Normalized words matched by literals and alternations
+    if (atom_kind == Literal) {
+        return QStringList(literal);
+    } else {
+        return alternatives.toList();
+    }
+}
+
+bool PatternAtom::matches(const Token &token) const
+{
+    switch (atom_kind)
+    {
+        case Placeholder:
+        case CatchAll:
+            return true;
+
+        case Literal:
+            return token.toKey() == literal;
+
+        case Alternation:
+            return alternatives.contains(token.toKey());
+
+        case RegularExpression:
+        {
+            // QRegExp keeps the state of the last match, use a copy sharing
+            // the compiled engine so that parsers can be used by many threads
+            QRegExp rx(regexp);
+
+            return rx.exactMatch(token.toString());
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,73 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __PATTERNATOM_H__
+#define __PATTERNATOM_H__
+
+#include <QString>
+#include <QStringList>
+#include <QSet>
+#include <QRegExp>
+
+struct Token;
+
+/**
+ * Element of a pattern ("%1", "...", "sent", "(at|on)", etc), classified and
+ * compiled once when the rule is loaded.
+ *
+ * Plain words are normalized like the keys of the tokens (see Token::normalize())
+ * and compared with them, alternations of plain words are looked up in a set,
+ * and only the remaining atoms go through QRegExp.
+ */
+class PatternAtom
+{
+    public:
+        enum Kind {
+            Placeholder,
+            CatchAll,
+            Literal,
+            Alternation,
+            RegularExpression
+        };
+
+    public:
+        PatternAtom();
+        explicit PatternAtom(const QString &pattern);
+
+        Kind kind() const;
+        int captureIndex() const;
+        const QString &pattern() const;
+        QStringList words() const;
+
+        bool matches(const Token &token) const;
+
+    private:
+        static bool unescapeWord(const QString &pattern, QString &word);
+
+    private:
+        QString atom_pattern;
+        Kind atom_kind;
+        int capture_index;
+
+        QString literal;
+        QSet<QString> alternatives;
+        QRegExp regexp;
+};
+
+#endif
@@ -0,0 +1,679 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "patternautomaton.h"
+#include "rule.h"
+
+#include <QtAlgorithms>
+
+static bool matchLessThan(const PatternAutomaton::Match &a, const PatternAutomaton::Match &b)
+{
+    return a.pattern < b.pattern;
+}
+
+template<typename T>
+static void copyTable(QVector<T> &vector, const T *table, int count)
+{
+    vector.resize(count);
+    qCopy(table, table + count, vector.begin());
+}
+
+PatternAutomaton::PatternAutomaton()
+: owned(true)
+{
+    // Root node
+    Node root;
+
+    root.parent = -1;
+    root.kind = PatternAtom::Literal;
+    root.capture_index = -1;
+    root.pattern = -1;
+    root.first_word = 0;
+    root.word_count = 0;
+    root.regexp = -1;
+    root.catchall_pattern = -1;
+    root.first_child = -1;
+    root.next_sibling = -1;
+    root.first_other = -1;
+    root.next_other = -1;
+    root.first_literal = 0;
+    root.literal_count = 0;
+    root.first_pattern = -1;
+
+    nodes.append(root);
+
+    data.max_capture_count = 0;
+    data.max_length = 0;
+    updateTables();
+}
+
+PatternAutomaton::PatternAutomaton(const Tables &tables)
+: data(tables),
+  owned(false)
+{
+    compileRegExps();
+}
+
+PatternAutomaton::PatternAutomaton(const PatternAutomaton &other)
+: data(other.data),
+  owned(other.owned),
+  nodes(other.nodes),
+  literal_edges(other.literal_edges),
+  words(other.words),
+  patterns(other.patterns),
+  capture_types(other.capture_types),
+  strings(other.strings),
+  characters(other.characters),
+  string_indexes(other.string_indexes),
+  regexps(other.regexps)
+{
+    if (owned) {
+        updateTables();
+    }
+}
+
+PatternAutomaton &PatternAutomaton::operator=(const PatternAutomaton &other)
+{
+    data = other.data;
+    owned = other.owned;
+    nodes = other.nodes;
+    literal_edges = other.literal_edges;
+    words = other.words;
+    patterns = other.patterns;
+    capture_types = other.capture_types;
+    strings = other.strings;
+    characters = other.characters;
+    string_indexes = other.string_indexes;
+    regexps = other.regexps;
+
+    if (owned) {
+        updateTables();
+    }
+
+    return *this;
+}
+
+void PatternAutomaton::detach()
+{
+    // Patterns added to an automaton compiled into the program go into a
+    // copy of its tables
+    if (owned) {
+        return;
+    }
+
+    string_indexes.clear();
+
+    copyTable(nodes, data.nodes, data.node_count);
+    copyTable(literal_edges, data.literal_edges, data.literal_edge_count);
+    copyTable(words, data.words, data.word_count);
+    copyTable(patterns, data.patterns, data.pattern_count);
+    copyTable(capture_types, data.capture_types, data.capture_type_count);
+    copyTable(strings, data.strings, data.string_count);
+    copyTable(characters, data.characters, data.character_count);
+
+    owned = true;
+    updateTables();
+
+    for (int i=0; i<strings.count(); ++i) {
+        string_indexes.insert(string(i), i);
+    }
+}
+
+void PatternAutomaton::updateTables()
+{
+    data.nodes = nodes.constData();
+    data.literal_edges = literal_edges.constData();
+    data.words = words.constData();
+    data.patterns = patterns.constData();
+    data.capture_types = capture_types.constData();
+    data.strings = strings.constData();
+    data.characters = characters.constData();
+    data.node_count = nodes.count();
+    data.literal_edge_count = literal_edges.count();
+    data.word_count = words.count();
+    data.pattern_count = patterns.count();
+    data.capture_type_count = capture_types.count();
+    data.string_count = strings.count();
+    data.character_count = characters.count();
+}
+
+void PatternAutomaton::compileRegExps()
+{
+    // The regexps of the nodes are numbered in node order
+    regexps.clear();
+
+    for (int i=0; i<data.node_count; ++i) {
+        if (data.nodes[i].regexp != -1) {
+            QRegExp regexp(string(data.nodes[i].pattern), Qt::CaseInsensitive, QRegExp::RegExp2);
+
+            regexp.isValid();   // Builds the matching engine now, not in a parsing thread
+            regexps.append(regexp);
+        }
+    }
+}
+
+const PatternAutomaton::Tables &PatternAutomaton::tables() const
+{
+    return data;
+}
+
+QString PatternAutomaton::string(int index) const
+{
+    const String &s = data.strings[index];
+
+    return QString(reinterpret_cast<const QChar *>(data.characters + s.offset), s.length);
+}
+
+int PatternAutomaton::addString(const QString &string)
+{
+    QHash<QString, int>::const_iterator it = string_indexes.constFind(string);
+
+    if (it != string_indexes.constEnd()) {
+        return it.value();
+    }
+
+    String s;
+
+    s.offset = characters.count();
+    s.length = string.size();
+
+    for (int i=0; i<string.size(); ++i) {
+        characters.append(string.at(i).unicode());
+    }
+
+    strings.append(s);
+    string_indexes.insert(string, strings.count() - 1);
+
+    return strings.count() - 1;
+}
+
+int PatternAutomaton::addPattern(const Pattern &pattern)
+{
+    detach();
+
+    int id = patterns.count();
+    int node = 0;
+    int catchall_pattern = -1;
+
+    Q_FOREACH(const PatternAtom &atom, pattern.atoms()) {
+        if (atom.kind() == PatternAtom::CatchAll) {
+            // "..." stops matching when the next atom of its own pattern is
+            // encountered. The nodes starting at "..." are therefore never
+            // shared with other patterns.
+            catchall_pattern = id;
+        }
+
+        node = child(node, atom, catchall_pattern);
+    }
+
+    PatternEnd end;
+
+    end.node = node;
+    end.next_pattern = -1;
+    end.capture_count = pattern.captureCount();
+    end.first_capture_type = capture_types.count();
+    end.capture_type_count = pattern.captureTypes().count();
+
+    Q_FOREACH(quint32 type, pattern.captureTypes()) {
+        capture_types.append(type);
+    }
+
+    patterns.append(end);
+
+    // Patterns ending at a node are kept in insertion order
+    if (nodes.at(node).first_pattern == -1) {
+        nodes[node].first_pattern = id;
+    } else {
+        int last = nodes.at(node).first_pattern;
+
+        while (patterns.at(last).next_pattern != -1) {
+            last = patterns.at(last).next_pattern;
+        }
+
+        patterns[last].next_pattern = id;
+    }
+
+    data.max_capture_count = qMax(int(data.max_capture_count), pattern.captureCount());
+
+    if (catchall_pattern != -1) {
+        data.max_length = -1;
+    } else if (data.max_length != -1) {
+        data.max_length = qMax(int(data.max_length), pattern.atoms().count());
+    }
+
+    updateTables();
+
+    return id;
+}
+
+int PatternAutomaton::patternCount() const
+{
+    return data.pattern_count;
+}
+
+Pattern PatternAutomaton::pattern(int id) const
+{
+    // Atoms from the root to the node of the pattern
+    const PatternEnd &end = data.patterns[id];
+    QList<PatternAtom> atoms;
+    QVector<quint32> types;
+
+    for (int node = end.node; data.nodes[node].parent != -1; node = data.nodes[node].parent) {
+        atoms.prepend(PatternAtom(string(data.nodes[node].pattern)));
+    }
+
+    for (int i=0; i<end.capture_type_count; ++i) {
+        types.append(data.capture_types[end.first_capture_type + i]);
+    }
+
+    return Pattern(atoms, types);
+}
+
+QList<QStringList> PatternAutomaton::anchors(int id) const
+{
+    // Words of the literals and alternations before "...", the catch-all also
+    // matches until the end of the query
+    QList<QStringList> rs;
+
+    for (int node = data.patterns[id].node; data.nodes[node].parent != -1; node = data.nodes[node].parent) {
+        const Node &n = data.nodes[node];
+
+        if (n.kind == PatternAtom::CatchAll) {
+            rs.clear();
+        } else if (n.kind == PatternAtom::Literal || n.kind == PatternAtom::Alternation) {
+            QStringList anchor;
+
+            for (int i=0; i<n.word_count; ++i) {
+                anchor.append(string(data.words[n.first_word + i]));
+            }
+
+            rs.prepend(anchor);
+        }
+    }
+
+    return rs;
+}
+
+int PatternAutomaton::firstAffectedIndex(int index) const
+{
+    // A match starting at a position reads at most max_length tokens. Only the
+    // matches reaching index can change when the token at index is replaced.
+    if (data.max_length == -1) {
+        // "..." can read the whole token list
+        return 0;
+    }
+
+    return qMax(0, index - int(data.max_length) + 1);
+}
+
+int PatternAutomaton::horizon(const QVector<Token> &tokens, int index) const
+{
+    // End of the text covered by the tokens a match starting at index can read
+    int end = (data.max_length == -1 ? tokens.count() : qMin(tokens.count(), index + int(data.max_length)));
+    int rs = -1;
+
+    for (int i=index; i<end; ++i) {
+        const Token &token = tokens.at(i);
+
+        rs = qMax(rs, token.position + token.length);
+    }
+
+    return rs;
+}
+
+int PatternAutomaton::child(int parent, const PatternAtom &atom, int catchall_pattern)
+{
+    int pattern_string = addString(atom.pattern());
+    int last_child = -1;
+
+    for (int index = nodes.at(parent).first_child; index != -1; index = nodes.at(index).next_sibling) {
+        const Node &node = nodes.at(index);
+
+        // Share the node of another pattern having the same prefix
+        if (catchall_pattern == -1 && node.catchall_pattern == -1 && node.pattern == pattern_string) {
+            return index;
+        }
+
+        last_child = index;
+    }
+
+    int index = nodes.count();
+    Node node;
+
+    node.parent = parent;
+    node.kind = atom.kind();
+    node.capture_index = atom.captureIndex();
+    node.pattern = pattern_string;
+    node.first_word = words.count();
+    node.word_count = 0;
+    node.regexp = -1;
+    node.catchall_pattern = catchall_pattern;
+    node.first_child = -1;
+    node.next_sibling = -1;
+    node.first_other = -1;
+    node.next_other = -1;
+    node.first_literal = 0;
+    node.literal_count = 0;
+    node.first_pattern = -1;
+
+    if (atom.kind() == PatternAtom::Literal || atom.kind() == PatternAtom::Alternation) {
+        Q_FOREACH(const QString &word, atom.words()) {
+            words.append(addString(word));
+            ++node.word_count;
+        }
+    } else if (atom.kind() == PatternAtom::RegularExpression) {
+        QRegExp regexp(atom.pattern(), Qt::CaseInsensitive, QRegExp::RegExp2);
+
+        regexp.isValid();
+        node.regexp = regexps.count();
+        regexps.append(regexp);
+    }
+
+    nodes.append(node);
+
+    if (last_child == -1) {
+        nodes[parent].first_child = index;
+    } else {
+        nodes[last_child].next_sibling = index;
+    }
+
+    if (node.word_count != 0) {
+        for (int i=0; i<node.word_count; ++i) {
+            addLiteralEdge(parent, words.at(node.first_word + i), index);
+        }
+    } else if (nodes.at(parent).first_other == -1) {
+        nodes[parent].first_other = index;
+    } else {
+        int last = nodes.at(parent).first_other;
+
+        while (nodes.at(last).next_other != -1) {
+            last = nodes.at(last).next_other;
+        }
+
+        nodes[last].next_other = index;
+    }
+
+    return index;
+}
+
+void PatternAutomaton::addLiteralEdge(int parent, int word, int child)
+{
+    // The edges of a node are contiguous and sorted by word. Equal words keep
+    // their insertion order, so that the children are explored in this order.
+    Node &node = nodes[parent];
+    int position = node.first_literal;
+    int end = node.first_literal + node.literal_count;
+
+    if (node.literal_count == 0) {
+        position = end = literal_edges.count();
+        node.first_literal = position;
+    }
+
+    while (position < end && compareStrings(literal_edges.at(position).word, word) <= 0) {
+        ++position;
+    }
+
+    LiteralEdge edge;
+
+    edge.word = word;
+    edge.child = child;
+    literal_edges.insert(position, edge);
+    ++node.literal_count;
+
+    // Move the edges of the nodes stored after the insertion point
+    for (int i=0; i<nodes.count(); ++i) {
+        if (i != parent && nodes.at(i).literal_count != 0 && nodes.at(i).first_literal >= position) {
+            ++nodes[i].first_literal;
+        }
+    }
+}
+
+int PatternAutomaton::compareStrings(int a, int b) const
+{
+    return compareWord(string(a), b);
+}
+
+int PatternAutomaton::compareWord(const QString &key, int word) const
+{
+    // Shorter words first, then by UTF-16 code units
+    const String &s = data.strings[word];
+
+    if (key.size() != s.length) {
+        return key.size() < s.length ? -1 : 1;
+    }
+
+    const ushort *characters = data.characters + s.offset;
+
+    for (int i=0; i<s.length; ++i) {
+        ushort c = key.at(i).unicode();
+
+        if (c != characters[i]) {
+            return c < characters[i] ? -1 : 1;
+        }
+    }
+
+    return 0;
+}
+
+QList<PatternAutomaton::Match> PatternAutomaton::matchAt(const QVector<Token> &tokens, int index) const
+{
+    QList<Match> matches;
+    Cursor cursor;
+
+    cursor.token_index = index;
+    cursor.start_position = 1 << 30;
+    cursor.end_position = 0;
+
+    for (int i=0; i<data.max_capture_count; ++i) {
+        cursor.captures.append(Token());
+    }
+
+    explore(tokens, index, 0, cursor, matches);
+
+    // Preferred patterns first
+    qSort(matches.begin(), matches.end(), matchLessThan);
+
+    return matches;
+}
+
+void PatternAutomaton::explore(const QVector<Token> &tokens,
+                               int index,
+                               int node_index,
+                               const Cursor &cursor,
+                               QList<Match> &matches) const
+{
+    const Node &node = data.nodes[node_index];
+
+    addMatches(node_index, index, cursor, matches);
+
+    if (cursor.token_index == tokens.count()) {
+        // Patterns containing "..." typically end with an optional terminating
+        // token. Allow them to match even if we reach the end of the token list
+        // without encountering the terminating token.
+        if (node.catchall_pattern != -1 && node.first_pattern == -1) {
+            addMatch(node.catchall_pattern, index, cursor, matches);
+        }
+
+        return;
+    }
+
+    const Token &token = tokens.at(cursor.token_index);
+
+    if (node.literal_count != 0 && token.isLiteral()) {
+        // Binary search of the first edge having the key of the token
+        QString key = token.toKey();
+        int first = node.first_literal;
+        int end = node.first_literal + node.literal_count;
+
+        while (first < end) {
+            int middle = (first + end) / 2;
+
+            if (compareWord(key, data.literal_edges[middle].word) > 0) {
+                first = middle + 1;
+            } else {
+                end = middle;
+            }
+        }
+
+        end = node.first_literal + node.literal_count;
+
+        for (int i=first; i<end && compareWord(key, data.literal_edges[i].word) == 0; ++i) {
+            advance(tokens, index, data.literal_edges[i].child, cursor, matches);
+        }
+    }
+
+    for (int child_index = node.first_other; child_index != -1; child_index = data.nodes[child_index].next_other) {
+        if (data.nodes[child_index].kind == PatternAtom::CatchAll) {
+            matchAnything(tokens, index, child_index, cursor, matches);
+        } else if (matchToken(token, child_index)) {
+            advance(tokens, index, child_index, cursor, matches);
+        }
+    }
+}
+
+void PatternAutomaton::advance(const QVector<Token> &tokens,
+                               int index,
+                               int node_index,
+                               Cursor cursor,
+                               QList<Match> &matches) const
+{
+    const Token &token = tokens.at(cursor.token_index);
+    const Node &node = data.nodes[node_index];
+
+    if (node.kind == PatternAtom::Placeholder && node.capture_index >= 0) {
+        cursor.captures[node.capture_index] = token;
+    }
+
+    cursor.start_position = qMin(cursor.start_position, token.position);
+    cursor.end_position = qMax(cursor.end_position, token.position + token.length);
+    ++cursor.token_index;
+
+    explore(tokens, index, node_index, cursor, matches);
+}
+
+void PatternAutomaton::matchAnything(const QVector<Token> &tokens,
+                                     int index,
+                                     int node_index,
+                                     Cursor cursor,
+                                     QList<Match> &matches) const
+{
+    const Node &node = data.nodes[node_index];
+
+    if (node.first_child == -1) {
+        // "..." ends the pattern, nothing more has to be matched
+        addMatches(node_index, index, cursor, matches);
+        return;
+    }
+
+    // Match anything until the terminating atom is encountered
+    int terminator_index = node.first_child;
+
+    while (cursor.token_index < tokens.count()) {
+        const Token &token = tokens.at(cursor.token_index);
+
+        cursor.start_position = qMin(cursor.start_position, token.position);
+        cursor.end_position = qMax(cursor.end_position, token.position + token.length);
+        ++cursor.token_index;
+
+        if (matchToken(token, terminator_index)) {
+            explore(tokens, index, terminator_index, cursor, matches);
+            return;
+        }
+
+        cursor.extra_tokens.append(token);
+    }
+
+    // End of the token list reached without encountering the terminating atom
+    addMatch(node.catchall_pattern, index, cursor, matches);
+}
+
+void PatternAutomaton::addMatches(int node_index, int index, const Cursor &cursor, QList<Match> &matches) const
+{
+    for (int pattern = data.nodes[node_index].first_pattern; pattern != -1; pattern = data.patterns[pattern].next_pattern) {
+        addMatch(pattern, index, cursor, matches);
+    }
+}
+
+void PatternAutomaton::addMatch(int pattern, int index, const Cursor &cursor, QList<Match> &matches) const
+{
+    if (cursor.token_index == index) {
+        // Empty patterns never match
+        return;
+    }
+
+    if (!matchCaptures(pattern, cursor)) {
+        return;
+    }
+
+    Match match;
+
+    match.pattern = pattern;
+    match.length = cursor.token_index - index;
+    match.start_position = cursor.start_position;
+    match.end_position = cursor.end_position;
+    match.matched_tokens = cursor.captures.mid(0, data.patterns[pattern].capture_count);
+    match.matched_tokens += cursor.extra_tokens;
+
+    matches.append(match);
+}
+
+bool PatternAutomaton::matchCaptures(int pattern, const Cursor &cursor) const
+{
+    const PatternEnd &end = data.patterns[pattern];
+    int count = qMin(end.capture_type_count, end.capture_count);
+
+    for (int i=0; i<count; ++i) {
+        if ((cursor.captures.at(i).typeBit() & data.capture_types[end.first_capture_type + i]) == 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool PatternAutomaton::matchToken(const Token &token, int node_index) const
+{
+    const Node &node = data.nodes[node_index];
+
+    if (node.kind == PatternAtom::Placeholder || node.kind == PatternAtom::CatchAll) {
+        return true;
+    }
+
+    if (!token.isLiteral()) {
+        return false;
+    }
+
+    if (node.kind == PatternAtom::RegularExpression) {
+        // QRegExp keeps the state of the last match, use a copy sharing
+        // the compiled engine so that parsers can be used by many threads
+        QRegExp rx(regexps.at(node.regexp));
+
+        return rx.exactMatch(token.toString());
+    }
+
+    QString key = token.toKey();
+
+    for (int i=0; i<node.word_count; ++i) {
+        if (compareWord(key, data.words[node.first_word + i]) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
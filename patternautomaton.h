@@ -0,0 +1,200 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __PATTERNAUTOMATON_H__
+#define __PATTERNAUTOMATON_H__
+
+#include "patternatom.h"
+
+#include "token.h"
+
+#include <QList>
+#include <QVector>
+#include <QHash>
+#include <QRegExp>
+#include <QStringList>
+
+class Pattern;
+
+/**
+ * Prefix automaton built from the atoms of many patterns.
+ *
+ * Patterns sharing a prefix share the nodes of that prefix, so every pattern
+ * that can start at a given position of the token list is explored in one
+ * descent. Literal words and alternations are dispatched with a binary search
+ * in the sorted literal edges of a node, placeholders are wildcard edges that
+ * match any token.
+ *
+ * The tokens captured by a pattern are checked against the capture types of
+ * the pattern before a match is built, so that the pass of the rule is not
+ * run on tokens it would reject anyway.
+ *
+ * Pattern identifiers are given in insertion order and are also the priority
+ * of the patterns: when several patterns match at the same position, the one
+ * with the lowest identifier is the preferred one.
+ *
+ * The automaton is stored in flat tables of plain structures. They are
+ * filled by addPattern(), or generated at build time and compiled into the
+ * program (see builtinrules.h), in which case they are used in place.
+ */
+class PatternAutomaton
+{
+    public:
+        struct Match {
+            int pattern;
+            int length;
+            int start_position;
+            int end_position;
+            QVector<Token> matched_tokens;
+        };
+
+        // Lists of nodes and patterns are linked by index, -1 ends them
+        struct Node {
+            qint32 parent;              // -1 for the root
+            qint32 kind;                // PatternAtom::Kind of the atom leading to this node
+            qint32 capture_index;
+            qint32 pattern;             // String of the atom, -1 for the root
+            qint32 first_word;          // Words of a literal or an alternation
+            qint32 word_count;
+            qint32 regexp;              // Regular expression of the atom, or -1
+            qint32 catchall_pattern;    // Pattern owning a node after "...", or -1
+            qint32 first_child;         // Every child, in insertion order
+            qint32 next_sibling;
+            qint32 first_other;         // Placeholders, regexps and "..."
+            qint32 next_other;
+            qint32 first_literal;       // Literal edges, sorted by word
+            qint32 literal_count;
+            qint32 first_pattern;       // Patterns ending at this node
+        };
+
+        struct LiteralEdge {
+            qint32 word;                // String of the word
+            qint32 child;
+        };
+
+        struct PatternEnd {
+            qint32 node;
+            qint32 next_pattern;        // Next pattern ending at the same node
+            qint32 capture_count;
+            qint32 first_capture_type;
+            qint32 capture_type_count;
+        };
+
+        struct String {
+            qint32 offset;              // In the UTF-16 characters of the tables
+            qint32 length;
+        };
+
+        struct Tables {
+            const Node *nodes;
+            const LiteralEdge *literal_edges;
+            const qint32 *words;
+            const PatternEnd *patterns;
+            const quint32 *capture_types;
+            const String *strings;
+            const ushort *characters;
+            qint32 node_count;
+            qint32 literal_edge_count;
+            qint32 word_count;
+            qint32 pattern_count;
+            qint32 capture_type_count;
+            qint32 string_count;
+            qint32 character_count;
+            qint32 max_capture_count;
+            qint32 max_length;          // -1 if a pattern contains "..."
+        };
+
+    public:
+        PatternAutomaton();
+        explicit PatternAutomaton(const Tables &tables);    // Not copied, must outlive the automaton
+        PatternAutomaton(const PatternAutomaton &other);
+        PatternAutomaton &operator=(const PatternAutomaton &other);
+
+        int addPattern(const Pattern &pattern);
+        int patternCount() const;
+        Pattern pattern(int id) const;
+        QList<QStringList> anchors(int id) const;
+        const Tables &tables() const;
+
+        QString string(int index) const;
+
+        int firstAffectedIndex(int index) const;
+        int horizon(const QVector<Token> &tokens, int index) const;
+
+        QList<Match> matchAt(const QVector<Token> &tokens, int index) const;
+
+    private:
+        struct Cursor {
+            int token_index;
+            int start_position;
+            int end_position;
+            QVector<Token> captures;
+            QVector<Token> extra_tokens;       // Tokens matched by "..."
+        };
+
+        void detach();
+        void updateTables();
+        void compileRegExps();
+
+        int addString(const QString &string);
+        int child(int parent, const PatternAtom &atom, int catchall_pattern);
+        void addLiteralEdge(int parent, int word, int child);
+
+        void explore(const QVector<Token> &tokens,
+                     int index,
+                     int node_index,
+                     const Cursor &cursor,
+                     QList<Match> &matches) const;
+        void advance(const QVector<Token> &tokens,
+                     int index,
+                     int node_index,
+                     Cursor cursor,
+                     QList<Match> &matches) const;
+        void matchAnything(const QVector<Token> &tokens,
+                           int index,
+                           int node_index,
+                           Cursor cursor,
+                           QList<Match> &matches) const;
+        void addMatches(int node_index, int index, const Cursor &cursor, QList<Match> &matches) const;
+        void addMatch(int pattern, int index, const Cursor &cursor, QList<Match> &matches) const;
+
+        bool matchCaptures(int pattern, const Cursor &cursor) const;
+        bool matchToken(const Token &token, int node_index) const;
+
+        int compareWord(const QString &key, int word) const;
+        int compareStrings(int a, int b) const;
+
+    private:
+        Tables data;                        // Points to the vectors below, or to static tables
+        bool owned;
+
+        // Filled by addPattern()
+        QVector<Node> nodes;
+        QVector<LiteralEdge> literal_edges;
+        QVector<qint32> words;
+        QVector<PatternEnd> patterns;
+        QVector<quint32> capture_types;
+        QVector<String> strings;
+        QVector<ushort> characters;
+        QHash<QString, int> string_indexes;
+
+        QVector<QRegExp> regexps;           // Compiled once, for the nodes having a regexp
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,157 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "querycache.h"
+#include "pass_dateperiods.h"
+
+#include <QMutexLocker>
+
+QueryCache::QueryCache()
+: entries(0),
+  hit_count(0),
+  miss_count(0)
+{
+}
+
+QueryCache::QueryCache(const QueryCache &other)
+: entries(other.maxSize()),
+  hit_count(0),
+  miss_count(0)
+{
+    // Only the settings are copied, the copy starts empty
+}
+
+void QueryCache::setMaxSize(int max_size)
+{
+    QMutexLocker locker(&mutex);
+
+    entries.setMaxCost(max_size);
+}
+
+int QueryCache::maxSize() const
+{
+    QMutexLocker locker(&mutex);
+
+    return entries.maxCost();
+}
+
+bool QueryCache::find(const QString &key,
+                      int tag_generation,
+                      const QDateTime &now,
+                      Nepomuk2::Query::Query &query)
+{
+    QueryTemplate query_template;
+    qint64 time_bucket;
+
+    {
+        QMutexLocker locker(&mutex);
+        Entry *entry = entries.object(key);
+
+        if (entry && entry->tag_generation != tag_generation) {
+            // Stale result
+            entries.remove(key);
+            entry = 0;
+        }
+
+        if (!entry) {
+            ++miss_count;
+            return false;
+        }
+
+        ++hit_count;
+        time_bucket = timeBucket(entry->now_period, now);
+
+        if (entry->time_bucket == time_bucket) {
+            query = entry->query;
+            return true;
+        }
+
+        query_template = entry->query_template;
+    }
+
+    // Build the query for the new reference time without holding the lock,
+    // and keep it for the next lookups
+    query = query_template.instantiate(now);
+
+    QMutexLocker locker(&mutex);
+    Entry *entry = entries.object(key);
+
+    if (entry && entry->tag_generation == tag_generation) {
+        entry->query = query;
+        entry->time_bucket = time_bucket;
+    }
+
+    return true;
+}
+
+void QueryCache::insert(const QString &key,
+                        const QueryTemplate &query_template,
+                        const Nepomuk2::Query::Query &query,
+                        int tag_generation,
+                        int now_period,
+                        const QDateTime &now)
+{
+    QMutexLocker locker(&mutex);
+    Entry *entry = new Entry;
+
+    entry->query_template = query_template;
+    entry->query = query;
+    entry->tag_generation = tag_generation;
+    entry->now_period = now_period;
+    entry->time_bucket = timeBucket(now_period, now);
+
+    entries.insert(key, entry);
+}
+
+qint64 QueryCache::hits() const
+{
+    QMutexLocker locker(&mutex);
+
+    return hit_count;
+}
+
+qint64 QueryCache::misses() const
+{
+    QMutexLocker locker(&mutex);
+
+    return miss_count;
+}
+
+qint64 QueryCache::timeBucket(int now_period, const QDateTime &now)
+{
+    if (now_period < 0) {
+        return 0;
+    }
+
+    QTime time = now.time();
+    qint64 bucket = now.date().toJulianDay();
+
+    // The date fields of a date-time change at most once a day
+    if (now_period >= PassDatePeriods::Hour) {
+        bucket = bucket * 24 + time.hour();
+    }
+    if (now_period >= PassDatePeriods::Minute) {
+        bucket = bucket * 60 + time.minute();
+    }
+    if (now_period >= PassDatePeriods::Second) {
+        bucket = bucket * 60 + time.second();
+    }
+
+    return bucket;
+}
@@ -0,0 +1,81 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __QUERYCACHE_H__
+#define __QUERYCACHE_H__
+
+#include <QString>
+#include <QCache>
+#include <QMutex>
+#include <QDateTime>
+
+#include "parser.h"
+
+/**
+ * Bounded LRU cache of parsed queries, shared by the threads using a parser.
+ *
+ * The template of each query is kept, with the last query built from it. A
+ * query using the reference time is valid only during the period (day, hour,
+ * minute or second) it was built for, then it is built again from the
+ * template. Entries are discarded when the tags known by the parser change.
+ */
+class QueryCache
+{
+    public:
+        QueryCache();
+        QueryCache(const QueryCache &other);
+
+        void setMaxSize(int max_size);
+        int maxSize() const;
+
+        bool find(const QString &key,
+                  int tag_generation,
+                  const QDateTime &now,
+                  Nepomuk2::Query::Query &query);
+        void insert(const QString &key,
+                    const QueryTemplate &query_template,
+                    const Nepomuk2::Query::Query &query,
+                    int tag_generation,
+                    int now_period,
+                    const QDateTime &now);
+
+        qint64 hits() const;
+        qint64 misses() const;
+
+    private:
+        struct Entry {
+            QueryTemplate query_template;
+            Nepomuk2::Query::Query query;
+            int tag_generation;
+            int now_period;         // Finest period of the current date-time used, -1 if none
+            qint64 time_bucket;
+        };
+
+        static qint64 timeBucket(int now_period, const QDateTime &now);
+
+        QueryCache &operator=(const QueryCache &other);
+
+    private:
+        mutable QMutex mutex;
+        QCache<QString, Entry> entries;
+        qint64 hit_count;
+        qint64 miss_count;
+};
+
+#endif
\ No newline at end of file
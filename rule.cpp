@@ -0,0 +1,125 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "rule.h"
+
+Pattern::Pattern()
+: capture_count(0)
+{
+}
+
+Pattern::Pattern(const QList<PatternAtom> &atoms, const QVector<quint32> &capture_types)
+: pattern_atoms(atoms),
+  capture_types(capture_types),
+  capture_count(0)
+{
+    Q_FOREACH(const PatternAtom &atom, atoms) {
+        if (atom.kind() == PatternAtom::Placeholder) {
+            capture_count = qMax(capture_count, atom.captureIndex() + 1);
+        }
+    }
+}
+
+const QList<PatternAtom> &Pattern::atoms() const
+{
+    return pattern_atoms;
+}
+
+int Pattern::captureCount() const
+{
+    return capture_count;
+}
+
+const QVector<quint32> &Pattern::captureTypes() const
+{
+    return capture_types;
+}
+
+Rule::Rule()
+: anchored(true)
+{
+}
+
+Rule::Rule(const PatternAutomaton &automaton)
+: rule_automaton(automaton),
+  anchored(true)
+{
+    for (int i=0; i<automaton.patternCount(); ++i) {
+        addAnchors(i);
+    }
+}
+
+void Rule::addPattern(const Pattern &pattern)
+{
+    addAnchors(rule_automaton.addPattern(pattern));
+}
+
+void Rule::addAnchors(int pattern)
+{
+    QList<QStringList> anchors = rule_automaton.anchors(pattern);
+
+    pattern_anchors.append(anchors);
+
+    if (anchors.isEmpty()) {
+        anchored = false;
+    }
+}
+
+const PatternAutomaton &Rule::automaton() const
+{
+    return rule_automaton;
+}
+
+bool Rule::isAnchored() const
+{
+    return anchored;
+}
+
+bool Rule::canMatch(const QSet<QString> &words) const
+{
+    if (!anchored) {
+        return true;
+    }
+
+    Q_FOREACH(const QList<QStringList> &anchors, pattern_anchors) {
+        bool found_all = true;
+
+        Q_FOREACH(const QStringList &anchor, anchors) {
+            bool found = false;
+
+            Q_FOREACH(const QString &word, anchor) {
+                if (words.contains(word)) {
+                    found = true;
+                    break;
+                }
+            }
+
+            if (!found) {
+                found_all = false;
+                break;
+            }
+        }
+
+        if (found_all) {
+            return true;
+        }
+    }
+
+    return false;
+}
\ No newline at end of file
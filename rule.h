@@ -0,0 +1,93 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __RULE_H__
+#define __RULE_H__
+
+#include "patternatom.h"
+#include "patternautomaton.h"
+
+#include <QList>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * One of the semicolon-separated alternatives of a rule, already split into
+ * compiled atoms.
+ *
+ * The types of tokens that the pass of the rule accepts for each capture are
+ * also kept, as masks of Token::typeBit(). A match capturing another type of
+ * token is discarded without running the pass.
+ */
+class Pattern
+{
+    public:
+        Pattern();
+        explicit Pattern(const QList<PatternAtom> &atoms,
+                         const QVector<quint32> &capture_types = QVector<quint32>());
+
+        const QList<PatternAtom> &atoms() const;
+        int captureCount() const;
+        const QVector<quint32> &captureTypes() const;
+
+    private:
+        QList<PatternAtom> pattern_atoms;
+        QVector<quint32> capture_types;     // Types accepted by the first captures
+        int capture_count;
+};
+
+/**
+ * Translated rule ("sent by %1;from %1"), compiled once when the parser is
+ * built. The patterns are kept in declaration order, as it is also their
+ * priority order.
+ *
+ * The patterns are merged in a prefix automaton, so that every alternative of
+ * the rule is explored in one descent at a given position. The automaton can
+ * also come from the tables compiled into the program (see builtinrules.h).
+ *
+ * The words that a pattern cannot match without (its anchors) are recorded,
+ * so that a rule is not run on a query containing none of them.
+ */
+class Rule
+{
+    public:
+        Rule();
+        explicit Rule(const PatternAutomaton &automaton);
+
+        void addPattern(const Pattern &pattern);
+
+        const PatternAutomaton &automaton() const;
+
+        bool isAnchored() const;
+        bool canMatch(const QSet<QString> &words) const;
+
+    private:
+        void addAnchors(int pattern);
+
+    private:
+        PatternAutomaton rule_automaton;
+
+        // For each pattern, lists of normalized words of which the query must
+        // contain at least one
+        QList<QList<QStringList> > pattern_anchors;
+        bool anchored;                  // False if a pattern has no anchor
+};
+
+#endif
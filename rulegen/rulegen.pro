@@ -0,0 +1,10 @@
+######################################################################
+# Parser without the builtin rules, that writes them for "parser"
+######################################################################
+
+TEMPLATE = app
+TARGET = parser-rulegen
+
+include(../parser.pri)
+
+SOURCES += ../main.cpp
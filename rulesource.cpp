@@ -0,0 +1,203 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "rulesource.h"
+#include "patternautomaton.h"
+#include "ruletable.h"
+
+#include <QtAlgorithms>
+
+RuleSourceWriter::RuleSourceWriter()
+: array_count(0)
+{
+}
+
+QByteArray RuleSourceWriter::string(const QString &string)
+{
+    // UTF-8 literal, everything but plain ASCII is escaped
+    QByteArray utf8 = string.toUtf8();
+    QByteArray rs = "\"";
+
+    for (int i=0; i<utf8.size(); ++i) {
+        uchar c = uchar(utf8.at(i));
+
+        if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\' && c != '?') {
+            rs += char(c);
+        } else {
+            rs += '\\' + QByteArray::number(c, 8).rightJustified(3, '0');
+        }
+    }
+
+    return rs + '"';
+}
+
+QByteArray RuleSourceWriter::number(qint64 value)
+{
+    if (value < -0x7fffffffLL || value > 0x7fffffffLL) {
+        return "Q_INT64_C(" + QByteArray::number(value) + ')';
+    }
+
+    return QByteArray::number(value);
+}
+
+QByteArray RuleSourceWriter::record(const QList<QByteArray> &fields)
+{
+    QByteArray rs = "{";
+
+    for (int i=0; i<fields.count(); ++i) {
+        rs += (i == 0 ? "" : ", ");
+        rs += fields.at(i);
+    }
+
+    return rs + '}';
+}
+
+QByteArray RuleSourceWriter::addArray(const char *type, const QList<QByteArray> &elements)
+{
+    QByteArray name = "table_" + QByteArray::number(array_count++);
+
+    definitions += "static const ";
+    definitions += type;
+    definitions += ' ' + name;
+
+    if (elements.isEmpty()) {
+        // Arrays cannot be empty, their size is given next to them
+        definitions += "[1] = {};\n\n";
+        return name;
+    }
+
+    definitions += "[] = {";
+
+    for (int i=0; i<elements.count(); ++i) {
+        definitions += "\n    " + elements.at(i) + ',';
+    }
+
+    definitions += "\n};\n\n";
+
+    return name;
+}
+
+QByteArray RuleSourceWriter::addWords(const QHash<QString, qint64> &words)
+{
+    // Sorted so that the generated file does not depend on the hash order
+    QStringList keys = words.keys();
+    QList<QByteArray> elements;
+
+    qSort(keys);
+
+    Q_FOREACH(const QString &key, keys) {
+        elements.append(record(QList<QByteArray>() << string(key) << number(words.value(key))));
+    }
+
+    return record(QList<QByteArray>() << addArray("BuiltinWord", elements) << number(keys.count()));
+}
+
+QByteArray RuleSourceWriter::addStrings(const QStringList &strings)
+{
+    QList<QByteArray> elements;
+
+    Q_FOREACH(const QString &s, strings) {
+        elements.append(string(s));
+    }
+
+    return addArray("char *const", elements);
+}
+
+QByteArray RuleSourceWriter::addAutomaton(const PatternAutomaton &automaton)
+{
+    const PatternAutomaton::Tables &tables = automaton.tables();
+    QList<QByteArray> nodes, literal_edges, words, patterns, capture_types, strings, characters;
+
+    for (int i=0; i<tables.node_count; ++i) {
+        const PatternAutomaton::Node &n = tables.nodes[i];
+
+        nodes.append(record(QList<QByteArray>()
+            << number(n.parent) << number(n.kind) << number(n.capture_index) << number(n.pattern)
+            << number(n.first_word) << number(n.word_count) << number(n.regexp) << number(n.catchall_pattern)
+            << number(n.first_child) << number(n.next_sibling) << number(n.first_other) << number(n.next_other)
+            << number(n.first_literal) << number(n.literal_count) << number(n.first_pattern)));
+    }
+
+    for (int i=0; i<tables.literal_edge_count; ++i) {
+        const PatternAutomaton::LiteralEdge &e = tables.literal_edges[i];
+
+        literal_edges.append(record(QList<QByteArray>() << number(e.word) << number(e.child)));
+    }
+
+    for (int i=0; i<tables.word_count; ++i) {
+        words.append(number(tables.words[i]));
+    }
+
+    for (int i=0; i<tables.pattern_count; ++i) {
+        const PatternAutomaton::PatternEnd &p = tables.patterns[i];
+
+        patterns.append(record(QList<QByteArray>()
+            << number(p.node) << number(p.next_pattern) << number(p.capture_count)
+            << number(p.first_capture_type) << number(p.capture_type_count)));
+    }
+
+    for (int i=0; i<tables.capture_type_count; ++i) {
+        capture_types.append(number(tables.capture_types[i]) + 'u');
+    }
+
+    for (int i=0; i<tables.string_count; ++i) {
+        const PatternAutomaton::String &s = tables.strings[i];
+
+        strings.append(record(QList<QByteArray>() << number(s.offset) << number(s.length)));
+    }
+
+    for (int i=0; i<tables.character_count; ++i) {
+        characters.append(QByteArray::number(tables.characters[i]));
+    }
+
+    QList<QByteArray> fields;
+
+    fields << addArray("PatternAutomaton::Node", nodes)
+           << addArray("PatternAutomaton::LiteralEdge", literal_edges)
+           << addArray("qint32", words)
+           << addArray("PatternAutomaton::PatternEnd", patterns)
+           << addArray("quint32", capture_types)
+           << addArray("PatternAutomaton::String", strings)
+           << addArray("ushort", characters)
+           << number(tables.node_count) << number(tables.literal_edge_count)
+           << number(tables.word_count) << number(tables.pattern_count)
+           << number(tables.capture_type_count) << number(tables.string_count)
+           << number(tables.character_count)
+           << number(tables.max_capture_count) << number(tables.max_length);
+
+    QByteArray name = "table_" + QByteArray::number(array_count++);
+
+    definitions += "static const PatternAutomaton::Tables " + name + " = " + record(fields) + ";\n\n";
+
+    return '&' + name;
+}
+
+QByteArray RuleSourceWriter::source(const QByteArray &builtin_rules) const
+{
+    QByteArray rs;
+
+    rs += "/* Generated by \"parser-rulegen --generate-rules\" for the locale ";
+    rs += RuleTable::localeKey().toLatin1();
+    rs += ", do not edit */\n\n"
+          "#include \"builtinrules.h\"\n\n";
+    rs += definitions;
+    rs += "const BuiltinRules builtin_rules = " + builtin_rules + ";\n";
+
+    return rs;
+}
@@ -0,0 +1,59 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __RULESOURCE_H__
+#define __RULESOURCE_H__
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+class PatternAutomaton;
+
+/**
+ * Writer of builtinrules.cpp, the vocabularies and the automata of a parser
+ * as static C++ tables (see builtinrules.h).
+ *
+ * Every add method defines a static array and returns the expression that
+ * refers to it, to be used in the initializer of builtin_rules.
+ */
+class RuleSourceWriter
+{
+    public:
+        RuleSourceWriter();
+
+        QByteArray addWords(const QHash<QString, qint64> &words);
+        QByteArray addStrings(const QStringList &strings);
+        QByteArray addAutomaton(const PatternAutomaton &automaton);
+        QByteArray addArray(const char *type, const QList<QByteArray> &elements);
+
+        QByteArray source(const QByteArray &builtin_rules) const;
+
+        static QByteArray string(const QString &string);
+        static QByteArray number(qint64 value);
+        static QByteArray record(const QList<QByteArray> &fields);
+
+    private:
+        QByteArray definitions;
+        int array_count;
+};
+
+#endif
\ No newline at end of file
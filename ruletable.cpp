@@ -0,0 +1,122 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "ruletable.h"
+
+#include <kglobal.h>
+#include <klocale.h>
+
+#include <QFile>
+
+#include <stdio.h>
+
+RuleTable::RuleTable(const QString &path)
+: data_stream(0),
+  valid(false)
+{
+    QFile file(path);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    // Everything is decoded into the containers of the parser, the file is
+    // not used once the parser is built
+    decode(file.readAll());
+}
+
+void RuleTable::decode(const QByteArray &table_data)
+{
+    data = table_data;
+    data_stream = new QDataStream(data);
+    data_stream->setVersion(QDataStream::Qt_4_8);
+
+    quint32 magic;
+    quint32 version;
+    QString locale_key;
+
+    *data_stream >> magic >> version >> locale_key;
+
+    valid = (data_stream->status() == QDataStream::Ok &&
+             magic == quint32(Magic) &&
+             version == quint32(Version) &&
+             locale_key == localeKey());
+}
+
+RuleTable::~RuleTable()
+{
+    delete data_stream;
+}
+
+bool RuleTable::isValid() const
+{
+    return valid;
+}
+
+QDataStream &RuleTable::stream()
+{
+    return *data_stream;
+}
+
+QByteArray RuleTable::encode(const QByteArray &data)
+{
+    QByteArray rs;
+    QDataStream stream(&rs, QIODevice::WriteOnly);
+
+    stream.setVersion(QDataStream::Qt_4_8);
+    stream << quint32(Magic) << quint32(Version) << localeKey();
+
+    return rs + data;
+}
+
+bool RuleTable::write(const QString &path, const QByteArray &data)
+{
+    return writeFile(path, encode(data));
+}
+
+bool RuleTable::writeFile(const QString &path, const QByteArray &contents)
+{
+    // Write a temporary file and rename it, so that the processes loading the
+    // table never see a partial file
+    QString temporary_path = path + QLatin1String(".tmp");
+    QFile file(temporary_path);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+        file.write(contents) != contents.size()) {
+        file.remove();
+        return false;
+    }
+
+    file.close();
+
+    if (::rename(QFile::encodeName(temporary_path).constData(), QFile::encodeName(path).constData()) != 0) {
+        QFile::remove(temporary_path);
+        return false;
+    }
+
+    return true;
+}
+
+QString RuleTable::localeKey()
+{
+    // Translations and dates depend on the locale
+    const KLocale *locale = KGlobal::locale();
+
+    return QString::fromLatin1("%1:%2").arg(locale->language()).arg(int(locale->calendarSystem()));
+}
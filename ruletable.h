@@ -0,0 +1,70 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __RULETABLE_H__
+#define __RULETABLE_H__
+
+#include <QString>
+#include <QByteArray>
+#include <QDataStream>
+
+/**
+ * Versioned binary file containing the translated vocabularies and rules of
+ * a parser for a locale, so that a parser can be built without translating
+ * and compiling them again.
+ *
+ * The file is read at once and decoded into the containers of the parser. It
+ * is rejected if its version or its locale is not the current one. The rules
+ * of the untranslated locale are compiled into the program instead, see
+ * builtinrules.h.
+ */
+class RuleTable
+{
+    public:
+        enum {
+            Magic = 0x4e515254,     // "NQRT"
+            Version = 2
+        };
+
+    public:
+        explicit RuleTable(const QString &path);
+        ~RuleTable();
+
+        bool isValid() const;
+        QDataStream &stream();          // Positioned after the header if the table is valid
+
+        static bool write(const QString &path, const QByteArray &data);
+        static bool writeFile(const QString &path, const QByteArray &contents);
+        static QString localeKey();
+
+    private:
+        RuleTable(const RuleTable &other);
+        RuleTable &operator=(const RuleTable &other);
+
+        void decode(const QByteArray &table_data);
+
+        static QByteArray encode(const QByteArray &data);
+
+    private:
+        QByteArray data;
+        QDataStream *data_stream;       // 0 if the file cannot be read
+        bool valid;
+};
+
+#endif
\ No newline at end of file
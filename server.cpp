@@ -0,0 +1,370 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "server.h"
+#include "parser.h"
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QtDebug>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <signal.h>
+#include <string.h>
+#include <errno.h>
+
+static void appendJsonString(QByteArray &out, const QString &string)
+{
+    QByteArray utf8 = string.toUtf8();
+
+    out.append('"');
+
+    for (int i=0; i<utf8.size(); ++i) {
+        char c = utf8.at(i);
+
+        switch (c) {
+            case '"':
+                out.append("\\\"");
+                break;
+            case '\\':
+                out.append("\\\\");
+                break;
+            case '\n':
+                out.append("\\n");
+                break;
+            case '\r':
+                out.append("\\r");
+                break;
+            case '\t':
+                out.append("\\t");
+                break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    out.append("\\u00");
+                    out.append("0123456789abcdef"[(c >> 4) & 0xf]);
+                    out.append("0123456789abcdef"[c & 0xf]);
+                } else {
+                    out.append(c);
+                }
+        }
+    }
+
+    out.append('"');
+}
+
+static void appendResult(QByteArray &out, qint64 id, const QString &query, const Nepomuk2::Query::Query &result)
+{
+    out.append("{\"id\":");
+    out.append(QByteArray::number(id));
+    out.append(",\"query\":");
+    appendJsonString(out, query);
+    out.append(",\"valid\":");
+    out.append(result.isValid() ? "true" : "false");
+    out.append(",\"serialized\":");
+    appendJsonString(out, result.toString());
+    out.append(",\"sparql\":");
+    appendJsonString(out, result.toSparqlQuery());
+    out.append("}\n");
+}
+
+static void appendError(QByteArray &out, qint64 id, const QString &message)
+{
+    out.append("{\"id\":");
+    out.append(QByteArray::number(id));
+    out.append(",\"error\":");
+    appendJsonString(out, message);
+    out.append("}\n");
+}
+
+// Longest line accepted by serve(), the bytes of a client are not kept in
+// memory without limit while it does not send a new line
+static const int max_line_length = 64 * 1024;
+
+static bool writeAll(int fd, const QByteArray &data)
+{
+    const char *ptr = data.constData();
+    qint64 remaining = data.size();
+
+    while (remaining > 0) {
+        ssize_t written = ::write(fd, ptr, remaining);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return false;
+        }
+
+        ptr += written;
+        remaining -= written;
+    }
+
+    return true;
+}
+
+static bool answer(const Parser &parser, const QList<QByteArray> &lines, qint64 &next_id, int output_fd, bool in_parallel)
+{
+    QStringList queries;
+    QList<bool> rejected;
+
+    Q_FOREACH(QByteArray line, lines) {
+        if (line.endsWith('\r')) {
+            line.chop(1);
+        }
+
+        // Over-long lines keep their identifier but are not parsed
+        rejected.append(line.size() > max_line_length);
+
+        if (rejected.last()) {
+            line.clear();
+        }
+
+        queries.append(QString::fromUtf8(line.constData(), line.size()));
+    }
+
+    // Parse the queries received together, in parallel if allowed, and
+    // answer them in a single write
+    QList<Nepomuk2::Query::Query> results;
+
+    if (in_parallel) {
+        results = parser.parseBatch(queries);
+    } else {
+        Q_FOREACH(const QString &query, queries) {
+            results.append(parser.parse(query));
+        }
+    }
+
+    QByteArray out;
+
+    for (int i=0; i<queries.count(); ++i) {
+        if (rejected.at(i)) {
+            appendError(out, next_id++, QLatin1String("line too long"));
+        } else {
+            appendResult(out, next_id++, queries.at(i), results.at(i));
+        }
+    }
+
+    return writeAll(output_fd, out);
+}
+
+static int serve(const Parser &parser, int input_fd, int output_fd, bool in_parallel)
+{
+    QByteArray pending;
+    char buffer[65536];
+    qint64 next_id = 0;
+    bool discarding = false;
+
+    while (true) {
+        ssize_t count = ::read(input_fd, buffer, sizeof(buffer));
+
+        if (count < 0 && errno == EINTR) {
+            continue;
+        } else if (count < 0) {
+            return 1;
+        } else if (count == 0) {
+            break;
+        }
+
+        const char *data = buffer;
+
+        if (discarding) {
+            // Drop the rest of an over-long line, up to its new line
+            const char *newline = (const char *)memchr(buffer, '\n', count);
+
+            if (newline == 0) {
+                continue;
+            }
+
+            discarding = false;
+            count -= newline + 1 - buffer;
+            data = newline + 1;
+        }
+
+        pending.append(data, count);
+
+        // Answer every complete line received so far
+        int end = pending.lastIndexOf('\n');
+
+        if (end >= 0) {
+            QList<QByteArray> lines = pending.left(end).split('\n');
+
+            pending.remove(0, end + 1);
+
+            if (!answer(parser, lines, next_id, output_fd, in_parallel)) {
+                return 1;
+            }
+        }
+
+        // The line being received is already too long, it is answered now
+        // and its next bytes are ignored
+        if (pending.size() > max_line_length) {
+            QByteArray out;
+
+            appendError(out, next_id++, QLatin1String("line too long"));
+            pending.clear();
+            discarding = true;
+
+            if (!writeAll(output_fd, out)) {
+                return 1;
+            }
+        }
+    }
+
+    // Last query, not followed by a new line
+    if (!pending.isEmpty() && !answer(parser, QList<QByteArray>() << pending, next_id, output_fd, in_parallel)) {
+        return 1;
+    }
+
+    return 0;
+}
+
+int serveStream(const Parser &parser, int input_fd, int output_fd)
+{
+    return serve(parser, input_fd, output_fd, true);
+}
+
+// Clients served at the same time by serveSocket()
+static const int max_connections = 256;
+
+// Serves one client of the socket, the parser is shared by all of them.
+// The queries of a client are parsed in its own thread, the threads of the
+// other clients already use the other processors.
+struct ConnectionWorker : public QRunnable {
+    ConnectionWorker(const Parser &parser, int fd)
+    : parser(parser), fd(fd)
+    {}
+
+    void run()
+    {
+        serve(parser, fd, fd, false);
+        ::close(fd);
+    }
+
+    const Parser &parser;
+    int fd;
+};
+
+int serveSocket(const Parser &parser, const QString &path)
+{
+    QByteArray encoded_path = path.toLocal8Bit();
+    struct sockaddr_un address;
+
+    if (encoded_path.size() >= int(sizeof(address.sun_path))) {
+        qWarning() << "Socket path too long:" << path;
+        return 1;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, encoded_path.constData(), encoded_path.size());
+
+    int server_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (server_fd < 0) {
+        qWarning() << "Unable to create a socket:" << strerror(errno);
+        return 1;
+    }
+
+    ::unlink(encoded_path.constData());
+
+    if (::bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+        ::listen(server_fd, SOMAXCONN) < 0) {
+        qWarning() << "Unable to listen on" << path << ":" << strerror(errno);
+        ::close(server_fd);
+        return 1;
+    }
+
+    // Every client keeps a thread of the pool as long as it stays connected.
+    // The clients beyond the size of the pool are refused instead of waiting
+    // for a thread that may never be released.
+    QThreadPool pool;
+
+    pool.setMaxThreadCount(max_connections);
+
+    while (true) {
+        int client_fd = ::accept(server_fd, 0, 0);
+
+        if (client_fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+
+            qWarning() << "Unable to accept a client:" << strerror(errno);
+            break;
+        }
+
+        ConnectionWorker *worker = new ConnectionWorker(parser, client_fd);
+
+        if (!pool.tryStart(worker)) {
+            delete worker;
+            ::close(client_fd);
+        }
+    }
+
+    pool.waitForDone();
+    ::close(server_fd);
+
+    return 1;
+}
+
+// Runs a server while the main thread dispatches the events of the
+// application
+struct ServerThread : public QThread {
+    ServerThread(const Parser &parser, const QString &path)
+    : parser(parser), path(path), exit_code(1)
+    {}
+
+    void run()
+    {
+        if (path.isEmpty()) {
+            exit_code = serveStream(parser, STDIN_FILENO, STDOUT_FILENO);
+        } else {
+            exit_code = serveSocket(parser, path);
+        }
+    }
+
+    const Parser &parser;
+    QString path;
+    int exit_code;
+};
+
+int runServer(const Parser &parser, const QString &path)
+{
+    ServerThread thread(parser, path);
+
+    // A client or a reader closing its end early must not kill the server,
+    // writeAll() sees EPIPE and the server stops serving it
+    signal(SIGPIPE, SIG_IGN);
+
+    QObject::connect(&thread, SIGNAL(finished()), QCoreApplication::instance(), SLOT(quit()));
+
+    thread.start();
+    QCoreApplication::exec();
+    thread.wait();
+
+    return thread.exit_code;
+}
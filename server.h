@@ -0,0 +1,50 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <QString>
+
+class Parser;
+
+/**
+ * Server mode, run with "parser --server [socket path]". One parser is kept
+ * for the whole life of the process.
+ *
+ * Every line received is a query, and a JSON object is written on one line
+ * for each of them, in the same order. Clients can send many queries
+ * without waiting for their results: the queries received together are
+ * answered at once. serveStream() parses them as a batch, serveSocket()
+ * serves every client in a thread of its own.
+ *
+ * A line longer than 64 KiB is not parsed: its object only has an "error"
+ * member, and the rest of the line is ignored.
+ */
+int serveStream(const Parser &parser, int input_fd, int output_fd);
+int serveSocket(const Parser &parser, const QString &path);
+
+/**
+ * Runs serveStream() on the standard input and output, or serveSocket() if
+ * a path is given, in another thread. The event loop of the application
+ * runs meanwhile so that the parser is notified of the changes of Nepomuk.
+ */
+int runServer(const Parser &parser, const QString &path);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,484 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "sparqlemitter.h"
+#include "pass_dateperiods.h"
+#include "token.h"
+#include "utils.h"
+
+#include <nepomuk2/nie.h>
+#include <nepomuk2/nfo.h>
+#include <nepomuk2/nmo.h>
+#include <soprano/literalvalue.h>
+#include <soprano/node.h>
+
+/*
+ * Terms of a level of the query being written: the query itself, a
+ * parenthesized group or a subquery. The connectives are applied from left
+ * to right, like fuseTerms() does.
+ */
+struct SparqlLevel
+{
+    SparqlLevel(const QVector<Token> *tokens, int index, const Token *subquery, const QString &subject)
+    : tokens(tokens),
+      index(index),
+      subquery(subquery),
+      subject(subject),
+      is_union(false),
+      ignored_parentheses(0),
+      build_and(true),
+      build_not(false),
+      default_filesize_property(Nepomuk2::Vocabulary::NIE::byteSize()),
+      default_datetime_property(Nepomuk2::Vocabulary::NIE::created())
+    {}
+
+    void addPattern(const QString &added, int &variables);
+
+    const QVector<Token> *tokens;
+    int index;
+    const Token *subquery;              // Token of the subquery written by this level
+    QString subject;                    // Variable of the resources matched by the level
+
+    QString pattern;                    // Graph pattern of the terms already written
+    bool is_union;                      // The pattern is only a "{ a } UNION { b }" chain
+
+    int ignored_parentheses;            // Opened beyond FuseKeywords::MaxDepth
+    bool build_and;
+    bool build_not;
+    QUrl default_filesize_property;
+    QUrl default_datetime_property;
+};
+
+static QString variable(int &variables)
+{
+    return QLatin1String("?v") + QString::number(++variables);
+}
+
+void SparqlLevel::addPattern(const QString &added, int &variables)
+{
+    // Terms fused into an invalid term (empty parentheses) are not written
+    if (!added.isEmpty()) {
+        QString term = added;
+
+        if (build_not) {
+            term = QLatin1String("FILTER(!bif:exists((select (1 as ?dummy) where { ") + term +
+                   QLatin1String("}))) . ");
+
+            // A filter alone does not bind the subject, the group starting
+            // with it first selects every resource having a type
+            if (pattern.isEmpty() || !build_and) {
+                term = subject + QLatin1String(" a ") + variable(variables) +
+                       QLatin1String(" . ") + term;
+            }
+        }
+
+        if (pattern.isEmpty()) {
+            pattern = term;
+        } else if (build_and) {
+            // The patterns of a group are joined
+            pattern += term;
+            is_union = false;
+        } else if (is_union) {
+            pattern += QLatin1String("UNION { ") + term + QLatin1String("} ");
+        } else {
+            pattern = QLatin1String("{ ") + pattern +
+                      QLatin1String("} UNION { ") + term + QLatin1String("} ");
+            is_union = true;
+        }
+    }
+
+    // Default to AND, and don't invert terms
+    build_and = true;
+    build_not = false;
+}
+
+static QString containsQuery(const QString &text)
+{
+    // Full-text query of Virtuoso, the quotes of the text cannot be escaped.
+    // Prefixes shorter than 4 characters cannot be used with "*".
+    QString rs(QLatin1String("\"'"));
+
+    for (int i=0; i<text.size(); ++i) {
+        QChar c = text.at(i);
+
+        if (c != QLatin1Char('"') && c != QLatin1Char('\'') && c != QLatin1Char('\\')) {
+            rs.append(c);
+        }
+    }
+
+    if (text.size() >= 4) {
+        rs.append(QLatin1Char('*'));
+    }
+
+    rs.append(QLatin1String("'\""));
+
+    return rs;
+}
+
+static const char *filterOperator(Nepomuk2::Query::ComparisonTerm::Comparator comparator)
+{
+    switch (comparator)
+    {
+        case Nepomuk2::Query::ComparisonTerm::Greater:
+            return ">";
+        case Nepomuk2::Query::ComparisonTerm::Smaller:
+            return "<";
+        case Nepomuk2::Query::ComparisonTerm::GreaterOrEqual:
+            return ">=";
+        case Nepomuk2::Query::ComparisonTerm::SmallerOrEqual:
+            return "<=";
+        default:
+            // Equal, and Contains or Regexp compared with a value that is not a string
+            return "=";
+    }
+}
+
+static Soprano::LiteralValue literalValue(const Token &token)
+{
+    switch (token.kind)
+    {
+        case Token::String:
+            return Soprano::LiteralValue(token.string);
+        case Token::Integer:
+            return Soprano::LiteralValue(qlonglong(token.integer));
+        case Token::Double:
+            return Soprano::LiteralValue(token.real);
+        case Token::DateTime:
+            return Soprano::LiteralValue(token.toDateTime());
+        case Token::DatePeriod:
+            return Soprano::LiteralValue(int(token.integer));
+        default:
+            return Soprano::LiteralValue();
+    }
+}
+
+SparqlEmitter::SparqlEmitter(const QList<QUrl> &properties)
+{
+    QList<QUrl> known = properties;
+
+    // Default properties of the date-times and file sizes
+    known << Nepomuk2::Vocabulary::NIE::byteSize()
+          << Nepomuk2::Vocabulary::NIE::created()
+          << Nepomuk2::Vocabulary::NIE::contentSize()
+          << Nepomuk2::Vocabulary::NMO::receivedDate()
+          << Nepomuk2::Vocabulary::NFO::fileSize()
+          << Nepomuk2::Vocabulary::NFO::fileLastModified();
+
+    Q_FOREACH(const QUrl &property, known) {
+        if (!property.isEmpty()) {
+            resources.insert(property, Soprano::Node::resourceToN3(property));
+        }
+    }
+}
+
+QString SparqlEmitter::resource(const QUrl &uri) const
+{
+    QHash<QUrl, QString>::const_iterator it = resources.constFind(uri);
+
+    if (it != resources.constEnd()) {
+        return it.value();
+    }
+
+    return Soprano::Node::resourceToN3(uri);
+}
+
+QString SparqlEmitter::toSparql(const QVector<Token> &tokens,
+                                const Calendar &calendar,
+                                const FuseKeywords &keywords) const
+{
+    QVector<SparqlLevel> levels;
+    int variables = 0;
+
+    levels.reserve(4);
+    levels.append(SparqlLevel(&tokens, 0, 0, QLatin1String("?r")));
+
+    while (true) {
+        SparqlLevel &level = levels.last();
+        QString pattern;
+        bool level_done = (level.index >= level.tokens->count());
+
+        if (!level_done) {
+            const Token &token = level.tokens->at(level.index);
+
+            if (token.kind == Token::Subquery) {
+                // The resources of the subquery are compared with a new variable
+                QString subject = (token.comparison ? variable(variables) : level.subject);
+
+                levels.append(SparqlLevel(token.subquery.data(), 0, &token, subject));
+                continue;
+            } else if (token.isComparison()) {
+                appendToken(pattern, level.subject, token, calendar, variables);
+            } else if (token.kind == Token::ResourceType) {
+                updateDefaultProperties(token.url,
+                                        level.default_datetime_property,
+                                        level.default_filesize_property);
+                appendValue(pattern, level.subject, token, variables);
+            } else if (token.kind == Token::DateTime) {
+                QDateTime start;
+                QDateTime end;
+
+                dateTimeInterval(token, calendar, start, end);
+                appendInterval(pattern, level.subject, level.default_datetime_property,
+                               Soprano::LiteralValue(start), Soprano::LiteralValue(end), variables);
+            } else if (token.kind == Token::Integer) {
+                qint64 min_size;
+                qint64 max_size;
+
+                sizeInterval(token.integer, min_size, max_size);
+                appendInterval(pattern, level.subject, level.default_filesize_property,
+                               Soprano::LiteralValue(qlonglong(min_size)),
+                               Soprano::LiteralValue(qlonglong(max_size)), variables);
+            } else if (token.kind == Token::String) {
+                switch (keywords.keyword(token))
+                {
+                    case FuseKeywords::Or:
+                        level.build_and = false;
+                        ++level.index;
+                        continue;
+                    case FuseKeywords::And:
+                        level.build_and = true;
+                        ++level.index;
+                        continue;
+                    case FuseKeywords::Not:
+                        level.build_not = true;
+                        ++level.index;
+                        continue;
+                    case FuseKeywords::OpeningParenthesis:
+                        if (levels.count() < FuseKeywords::MaxDepth) {
+                            levels.append(SparqlLevel(level.tokens, level.index + 1, 0, level.subject));
+                        } else {
+                            // Too deep, written in this level as fuseTerms() does
+                            ++level.ignored_parentheses;
+                            ++level.index;
+                        }
+                        continue;
+                    case FuseKeywords::ClosingParenthesis:
+                        if (level.ignored_parentheses > 0) {
+                            --level.ignored_parentheses;
+                            ++level.index;
+                            continue;
+                        }
+
+                        level_done = true;
+                        break;
+                    case FuseKeywords::IgnoredWord:
+                        ++level.index;
+                        continue;
+                    case FuseKeywords::NoKeyword:
+                        appendValue(pattern, level.subject, token, variables);
+                        break;
+                }
+            } else {
+                appendValue(pattern, level.subject, token, variables);
+            }
+        }
+
+        if (level_done) {
+            QString fused = level.pattern;
+            QString subject = level.subject;
+            int index = level.index;
+            const Token *subquery = level.subquery;
+
+            if (levels.count() == 1) {
+                if (fused.isEmpty()) {
+                    return QString();
+                }
+
+                return QLatin1String("select distinct ?r where { ") + fused + QLatin1String("}");
+            }
+
+            levels.removeLast();
+
+            SparqlLevel &parent = levels.last();
+
+            if (subquery) {
+                if (subquery->comparison && !fused.isEmpty()) {
+                    // The parent is still at the subquery token
+                    QString property = (subquery->property.isEmpty() ?
+                        variable(variables) :
+                        resource(subquery->property));
+
+                    fused = parent.subject + QLatin1Char(' ') + property +
+                            QLatin1Char(' ') + subject + QLatin1String(" . ") + fused;
+                }
+            } else {
+                // The parent continues after the closing parenthesis
+                parent.index = index;
+            }
+
+            parent.addPattern(fused, variables);
+            ++parent.index;
+            continue;
+        }
+
+        level.addPattern(pattern, variables);
+        ++level.index;
+    }
+}
+
+void SparqlEmitter::appendToken(QString &out,
+                                const QString &subject,
+                                const Token &token,
+                                const Calendar &calendar,
+                                int &variables) const
+{
+    if (!token.comparison) {
+        appendValue(out, subject, token, variables);
+        return;
+    }
+
+    switch (token.kind)
+    {
+        case Token::DateTime:
+            if (token.comparator == Nepomuk2::Query::ComparisonTerm::Equal) {
+                // Comparison against the interval of the date-time, like
+                // fuseTerms() does
+                QDateTime start;
+                QDateTime end;
+
+                dateTimeInterval(token, calendar, start, end);
+                appendInterval(out, subject, token.property,
+                               Soprano::LiteralValue(start), Soprano::LiteralValue(end), variables);
+                break;
+            }
+
+            // Fall through
+        case Token::String:
+        case Token::Integer:
+        case Token::Double:
+            appendComparison(out, subject, token.property, token.comparator, literalValue(token), variables);
+            break;
+
+        case Token::Resource:
+            out += subject;
+            out += QLatin1Char(' ');
+            out += (token.property.isEmpty() ? variable(variables) : resource(token.property));
+            out += QLatin1Char(' ');
+            out += resource(token.url);
+            out += QLatin1String(" . ");
+            break;
+
+        default:
+        {
+            // Resource matching the value of the token
+            QString object = variable(variables);
+
+            out += subject;
+            out += QLatin1Char(' ');
+            out += (token.property.isEmpty() ? variable(variables) : resource(token.property));
+            out += QLatin1Char(' ');
+            out += object;
+            out += QLatin1String(" . ");
+
+            Token value = token;
+
+            value.comparison = false;
+            appendValue(out, object, value, variables);
+            break;
+        }
+    }
+}
+
+void SparqlEmitter::appendValue(QString &out,
+                                const QString &subject,
+                                const Token &token,
+                                int &variables) const
+{
+    switch (token.kind)
+    {
+        case Token::String:
+        case Token::Integer:
+        case Token::Double:
+        case Token::DateTime:
+            // Literal value of any property
+            appendComparison(out, subject, QUrl(),
+                             token.kind == Token::String ?
+                                Nepomuk2::Query::ComparisonTerm::Contains :
+                                Nepomuk2::Query::ComparisonTerm::Equal,
+                             literalValue(token), variables);
+            break;
+
+        case Token::DatePeriod:
+            appendComparison(out, subject,
+                             PassDatePeriods::propertyUrl(PassDatePeriods::Period(token.period), token.offset),
+                             Nepomuk2::Query::ComparisonTerm::Equal,
+                             literalValue(token), variables);
+            break;
+
+        case Token::ResourceType:
+            out += subject;
+            out += QLatin1String(" a ");
+            out += resource(token.url);
+            out += QLatin1String(" . ");
+            break;
+
+        case Token::Resource:
+            out += QLatin1String("FILTER(") + subject + QLatin1String("=") + resource(token.url);
+            out += QLatin1String(") . ");
+            break;
+
+        default:
+            break;
+    }
+}
+
+void SparqlEmitter::appendComparison(QString &out,
+                                     const QString &subject,
+                                     const QUrl &property,
+                                     Nepomuk2::Query::ComparisonTerm::Comparator comparator,
+                                     const Soprano::LiteralValue &value,
+                                     int &variables) const
+{
+    QString object = variable(variables);
+
+    out += subject;
+    out += QLatin1Char(' ');
+    out += (property.isEmpty() ? variable(variables) : resource(property));
+    out += QLatin1Char(' ');
+    out += object;
+    out += QLatin1String(" . ");
+
+    if (comparator == Nepomuk2::Query::ComparisonTerm::Contains && value.isString()) {
+        out += object;
+        out += QLatin1String(" bif:contains ");
+        out += containsQuery(value.toString());
+        out += QLatin1String(" . ");
+    } else if (comparator == Nepomuk2::Query::ComparisonTerm::Regexp) {
+        out += QLatin1String("FILTER(REGEX(STR(") + object + QLatin1String("), ");
+        out += Soprano::Node::literalToN3(Soprano::LiteralValue(value.toString()));
+        out += QLatin1String(", 'i')) . ");
+    } else {
+        out += QLatin1String("FILTER(") + object;
+        out += QLatin1String(filterOperator(comparator));
+        out += Soprano::Node::literalToN3(value);
+        out += QLatin1String(") . ");
+    }
+}
+
+void SparqlEmitter::appendInterval(QString &out,
+                                   const QString &subject,
+                                   const QUrl &property,
+                                   const Soprano::LiteralValue &min,
+                                   const Soprano::LiteralValue &max,
+                                   int &variables) const
+{
+    // Two comparisons, as in the AndTerm built by fuseTerms()
+    appendComparison(out, subject, property, Nepomuk2::Query::ComparisonTerm::GreaterOrEqual, min, variables);
+    appendComparison(out, subject, property, Nepomuk2::Query::ComparisonTerm::SmallerOrEqual, max, variables);
+}
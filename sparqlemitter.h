@@ -0,0 +1,85 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __SPARQLEMITTER_H__
+#define __SPARQLEMITTER_H__
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QList>
+#include <QUrl>
+#include <nepomuk2/comparisonterm.h>
+
+struct Token;
+struct FuseKeywords;
+class Calendar;
+
+namespace Soprano {
+    class LiteralValue;
+}
+
+/**
+ * Writes the SPARQL query of a list of tokens, without building the
+ * Nepomuk2::Query terms of fuseTerms() and serializing them.
+ *
+ * The tokens are grouped like fuseTerms() groups them, so the query selects
+ * the same resources as the one of Nepomuk2::Query::Query::toSparqlQuery(),
+ * but its text is not the same. The N3 forms of the properties used by the
+ * rules are built once, with the constructor.
+ */
+class SparqlEmitter
+{
+    public:
+        explicit SparqlEmitter(const QList<QUrl> &properties);
+
+        QString toSparql(const QVector<Token> &tokens,
+                         const Calendar &calendar,
+                         const FuseKeywords &keywords) const;
+
+    private:
+        QString resource(const QUrl &uri) const;
+
+        void appendToken(QString &out,
+                         const QString &subject,
+                         const Token &token,
+                         const Calendar &calendar,
+                         int &variables) const;
+        void appendValue(QString &out,
+                         const QString &subject,
+                         const Token &token,
+                         int &variables) const;
+        void appendComparison(QString &out,
+                              const QString &subject,
+                              const QUrl &property,
+                              Nepomuk2::Query::ComparisonTerm::Comparator comparator,
+                              const Soprano::LiteralValue &value,
+                              int &variables) const;
+        void appendInterval(QString &out,
+                            const QString &subject,
+                            const QUrl &property,
+                            const Soprano::LiteralValue &min,
+                            const Soprano::LiteralValue &max,
+                            int &variables) const;
+
+    private:
+        QHash<QUrl, QString> resources;     // N3 forms of the known properties
+};
+
+#endif
\ No newline at end of file
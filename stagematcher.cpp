@@ -0,0 +1,37 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "stagematcher.h"
+
+StageMatcher::StageMatcher(QVector<Token> &tokens, const PatternAutomaton &automaton)
+: tokens(tokens),
+  automaton(automaton)
+{
+}
+
+QList<PatternAutomaton::Match> StageMatcher::matchesAt(int index)
+{
+    // The walks go from left to right, the positions before index are
+    // already explored
+    while (matches.count() <= index) {
+        matches.append(automaton.matchAt(tokens, matches.count()));
+    }
+
+    return matches.at(index);
+}
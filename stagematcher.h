@@ -0,0 +1,108 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __STAGEMATCHER_H__
+#define __STAGEMATCHER_H__
+
+#include "patternautomaton.h"
+#include "incrementalscan.h"
+#include "utils.h"
+
+#include "token.h"
+#include <QList>
+#include <QVector>
+
+/**
+ * Matches the patterns of the rules of a stage, using the automaton built for
+ * the stage.
+ *
+ * The rules keep their priority: each call of runPasses() walks the tokens
+ * from left to right for one rule, and the rules are run in order like in
+ * sequential matching. The automaton explores the patterns of every rule in
+ * one descent, and the matches found at a position are kept for the next
+ * rules until a replacement changes the tokens they read. At a given
+ * position, the alternatives of a rule are tried in declaration order until
+ * its pass accepts a match. PatternMatcher also uses this walk for the
+ * automaton of a single rule.
+ */
+class StageMatcher
+{
+    public:
+        StageMatcher(QVector<Token> &tokens, const PatternAutomaton &automaton);
+
+        template<typename T>
+        int runPasses(const T &passes, IncrementalScan *scan = 0)
+        {
+            // A walk of a ParseSession continues from its checkpoint, if any
+            QVector<Token> walked_tokens = tokens;
+            int first_index = (scan ? scan->resume(tokens) : 0);
+            int attempts = 0;
+
+            if (tokens != walked_tokens) {
+                // The checkpoint replaced the tokens
+                matches.clear();
+            }
+
+            for (int index=first_index; index<tokens.count(); ++index) {
+                ++attempts;
+
+                if (scan) {
+                    scan->beforeMatch(tokens, index, automaton.horizon(tokens, index));
+                }
+
+                Q_FOREACH(const PatternAutomaton::Match &match, matchesAt(index)) {
+                    // Run the pass of the rule owning the pattern, the next
+                    // pattern is tried only if the pass rejects the match.
+                    // The patterns of the other rules are not accepted.
+                    QVector<Token> replacement = passes.run(match.pattern, match.matched_tokens);
+
+                    if (replacement.count() > 0) {
+                        replaceTokens(tokens, index, match.length, replacement, match.start_position, match.end_position);
+
+                        // Resume at the first position whose matches can see
+                        // the replacement. The positions before it have already
+                        // been explored and their tokens did not change.
+                        index = automaton.firstAffectedIndex(index);
+                        matches.resize(qMin(matches.count(), index));
+                        --index;
+                        break;
+                    }
+                }
+            }
+
+            if (scan) {
+                scan->finish(tokens);
+            }
+
+            // Number of positions at which the patterns were tried
+            return attempts;
+        }
+
+    private:
+        QList<PatternAutomaton::Match> matchesAt(int index);
+
+    private:
+        QVector<Token> &tokens;
+        const PatternAutomaton &automaton;
+
+        // Matches of the first positions of the tokens, found by the automaton
+        QVector<QList<PatternAutomaton::Match> > matches;
+};
+
+#endif
@@ -0,0 +1,364 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "statistics.h"
+
+#include <QTextStream>
+#include <QMutexLocker>
+#include <QHash>
+#include <QThreadStorage>
+#include <QtAlgorithms>
+
+// 1µs to 500ms, roughly three buckets per decade
+static const qint64 bucket_bounds[StatisticsCollector::BucketCount - 1] = {
+    1000LL, 2000LL, 5000LL,
+    10000LL, 20000LL, 50000LL,
+    100000LL, 200000LL, 500000LL,
+    1000000LL, 2000000LL, 5000000LL,
+    10000000LL, 100000000LL, 500000000LL
+};
+
+const QList<ParserStatistics::RuleStatistics> &ParserStatistics::rules() const
+{
+    return rule_statistics;
+}
+
+const QList<ParserStatistics::StepStatistics> &ParserStatistics::steps() const
+{
+    return step_statistics;
+}
+
+QVector<qint64> ParserStatistics::bucketBounds()
+{
+    QVector<qint64> rs;
+
+    for (int i=0; i<StatisticsCollector::BucketCount - 1; ++i) {
+        rs.append(bucket_bounds[i]);
+    }
+
+    return rs;
+}
+
+static QString labelValue(const QString &value)
+{
+    QString rs = value;
+
+    rs.replace(QLatin1Char('\\'), QLatin1String("\\\\"));
+    rs.replace(QLatin1Char('"'), QLatin1String("\\\""));
+    rs.replace(QLatin1Char('\n'), QLatin1String("\\n"));
+
+    return QLatin1Char('"') + rs + QLatin1Char('"');
+}
+
+static QString seconds(qint64 nsecs)
+{
+    return QString::number(double(nsecs) / 1e9, 'g', 9);
+}
+
+QString ParserStatistics::toOpenMetrics() const
+{
+    static const char *rule_counters[] = {"attempts", "matches", "replacements"};
+    static const char *rule_help[] = {
+        "Positions at which a rule was tried.",
+        "Matches of a rule given to its pass.",
+        "Matches of a rule accepted by its pass."
+    };
+
+    QString rs;
+    QTextStream out(&rs);
+
+    // Rule counters, the index of the rule distinguishes rules sharing a context
+    for (int c=0; c<3; ++c) {
+        QString family = QString::fromLatin1("nepomukqueryparser_rule_") + QLatin1String(rule_counters[c]);
+
+        out << "# TYPE " << family << " counter\n";
+        out << "# HELP " << family << ' ' << rule_help[c] << '\n';
+
+        for (int i=0; i<rule_statistics.count(); ++i) {
+            const RuleStatistics &rule = rule_statistics.at(i);
+            qint64 value = (c == 0 ? rule.attempts : c == 1 ? rule.matches : rule.replacements);
+
+            out << family << "_total{stage=" << labelValue(rule.stage)
+                << ",rule=" << labelValue(rule.name)
+                << ",index=\"" << i << "\"} " << value << '\n';
+        }
+    }
+
+    // Latency of the steps of a parse
+    QString family = QLatin1String("nepomukqueryparser_step_duration_seconds");
+
+    out << "# TYPE " << family << " histogram\n";
+    out << "# HELP " << family << " Duration of a step of a parse.\n";
+
+    Q_FOREACH(const StepStatistics &step, step_statistics) {
+        QString step_label = QLatin1String("step=") + labelValue(step.name);
+        qint64 cumulative = 0;
+
+        for (int b=0; b<step.bucket_counts.count(); ++b) {
+            QString bound = (b < StatisticsCollector::BucketCount - 1 ?
+                seconds(bucket_bounds[b]) : QString::fromLatin1("+Inf"));
+
+            cumulative += step.bucket_counts.at(b);
+            out << family << "_bucket{" << step_label << ",le=\"" << bound << "\"} " << cumulative << '\n';
+        }
+
+        out << family << "_count{" << step_label << "} " << step.count << '\n';
+        out << family << "_sum{" << step_label << "} " << seconds(step.sum_nsecs) << '\n';
+    }
+
+    out << "# EOF\n";
+    out.flush();
+
+    return rs;
+}
+
+void StatisticsCollector::Shard::addLatency(int step, qint64 nsecs)
+{
+    int bucket = 0;
+
+    while (bucket < BucketCount - 1 && nsecs > bucket_bounds[bucket]) {
+        ++bucket;
+    }
+
+    QMutexLocker locker(&mutex);
+    Histogram &histogram = steps[step];
+
+    histogram.buckets[bucket] += 1;
+    histogram.count += 1;
+    histogram.sum_nsecs += nsecs;
+}
+
+// Shards of a collector. The threads that used the collector keep it alive,
+// so that they can give their shard back when they exit.
+struct StatisticsCollector::ShardRegistry
+{
+    ShardRegistry()
+    : alive(1)
+    {}
+
+    ~ShardRegistry()
+    {
+        qDeleteAll(shards);
+    }
+
+    QAtomicInt alive;               // The collector is not destroyed
+    QMutex mutex;
+    QList<Shard *> shards;          // Owned, used or not
+    QList<Shard *> free_shards;     // Of the threads that exited
+};
+
+// Shards used by a thread, given back to their collector when it exits
+struct StatisticsCollector::ThreadShards
+{
+    struct Entry {
+        QSharedPointer<ShardRegistry> registry;
+        Shard *shard;
+    };
+
+    ~ThreadShards()
+    {
+        Q_FOREACH(const Entry &entry, entries) {
+            QMutexLocker locker(&entry.registry->mutex);
+
+            entry.registry->free_shards.append(entry.shard);
+        }
+    }
+
+    void forgetDestroyedCollectors()
+    {
+        QHash<int, Entry>::iterator it = entries.begin();
+
+        while (it != entries.end()) {
+            if (int(it.value().registry->alive)) {
+                ++it;
+            } else {
+                it = entries.erase(it);
+            }
+        }
+    }
+
+    QHash<int, Entry> entries;
+};
+
+static QAtomicInt next_collector_id;
+
+StatisticsCollector::StatisticsCollector()
+: enabled(0),
+  id(next_collector_id.fetchAndAddOrdered(1)),
+  registry(new ShardRegistry)
+{
+}
+
+StatisticsCollector::StatisticsCollector(const StatisticsCollector &other)
+: enabled(int(other.enabled)),
+  id(next_collector_id.fetchAndAddOrdered(1)),
+  rule_names(other.rule_names),
+  rule_stages(other.rule_stages),
+  step_names(other.step_names),
+  registry(new ShardRegistry)
+{
+    // Only the settings are copied, the copy starts with null counters
+}
+
+StatisticsCollector::~StatisticsCollector()
+{
+    // The shards are deleted once the threads that used them forget them
+    registry->alive.fetchAndStoreOrdered(0);
+}
+
+void StatisticsCollector::addRule(const QString &name, const QString &stage)
+{
+    rule_names.append(name);
+    rule_stages.append(stage);
+}
+
+int StatisticsCollector::ruleCount() const
+{
+    return rule_names.count();
+}
+
+void StatisticsCollector::setSteps(const QStringList &names)
+{
+    step_names = names;
+}
+
+void StatisticsCollector::setEnabled(bool enabled)
+{
+    this->enabled.fetchAndStoreOrdered(enabled ? 1 : 0);
+}
+
+bool StatisticsCollector::isEnabled() const
+{
+    return int(enabled) != 0;
+}
+
+StatisticsCollector::Shard *StatisticsCollector::shard() const
+{
+    static QThreadStorage<ThreadShards *> thread_shards;
+
+    if (!int(enabled)) {
+        return 0;
+    }
+
+    if (!thread_shards.hasLocalData()) {
+        thread_shards.setLocalData(new ThreadShards);
+    }
+
+    ThreadShards *local = thread_shards.localData();
+    QHash<int, ThreadShards::Entry>::const_iterator it = local->entries.constFind(id);
+
+    if (it != local->entries.constEnd()) {
+        return it.value().shard;
+    }
+
+    // First use of the collector by this thread, reuse the shard of a thread
+    // that exited if possible
+    ThreadShards::Entry entry;
+
+    entry.registry = registry;
+
+    {
+        QMutexLocker locker(&registry->mutex);
+
+        if (!registry->free_shards.isEmpty()) {
+            entry.shard = registry->free_shards.takeLast();
+        } else {
+            // The rules and steps are set while the parser is built, before
+            // any thread uses it
+            entry.shard = new Shard;
+            entry.shard->rules.resize(rule_names.count());
+            entry.shard->steps.resize(step_names.count());
+
+            registry->shards.append(entry.shard);
+        }
+    }
+
+    local->forgetDestroyedCollectors();
+    local->entries.insert(id, entry);
+
+    return entry.shard;
+}
+
+void StatisticsCollector::addLatency(int step, qint64 nsecs)
+{
+    Shard *current = shard();
+
+    if (current) {
+        current->addLatency(step, nsecs);
+    }
+}
+
+ParserStatistics StatisticsCollector::snapshot() const
+{
+    ParserStatistics rs;
+
+    for (int i=0; i<rule_names.count(); ++i) {
+        ParserStatistics::RuleStatistics rule;
+
+        rule.name = rule_names.at(i);
+        rule.stage = rule_stages.at(i);
+        rule.attempts = 0;
+        rule.matches = 0;
+        rule.replacements = 0;
+
+        rs.rule_statistics.append(rule);
+    }
+
+    for (int i=0; i<step_names.count(); ++i) {
+        ParserStatistics::StepStatistics step;
+
+        step.name = step_names.at(i);
+        step.bucket_counts = QVector<qint64>(BucketCount, 0);
+        step.count = 0;
+        step.sum_nsecs = 0;
+
+        rs.step_statistics.append(step);
+    }
+
+    // Sum the shards, each one is locked only while it is read
+    QMutexLocker shards_locker(&registry->mutex);
+
+    Q_FOREACH(Shard *s, registry->shards) {
+        Shard &shard = *s;
+        QMutexLocker locker(&shard.mutex);
+
+        for (int i=0; i<shard.rules.count(); ++i) {
+            ParserStatistics::RuleStatistics &rule = rs.rule_statistics[i];
+            const RuleCounters &counters = shard.rules.at(i);
+
+            rule.attempts += counters.attempts;
+            rule.matches += counters.matches;
+            rule.replacements += counters.replacements;
+        }
+
+        for (int i=0; i<shard.steps.count(); ++i) {
+            ParserStatistics::StepStatistics &step = rs.step_statistics[i];
+            const Histogram &histogram = shard.steps.at(i);
+
+            for (int b=0; b<BucketCount; ++b) {
+                step.bucket_counts[b] += histogram.buckets[b];
+            }
+
+            step.count += histogram.count;
+            step.sum_nsecs += histogram.sum_nsecs;
+        }
+    }
+
+    return rs;
+}
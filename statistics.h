@@ -0,0 +1,172 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __STATISTICS_H__
+#define __STATISTICS_H__
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QVector>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QAtomicInt>
+#include <QSharedPointer>
+
+/**
+ * Snapshot of the statistics of a parser: how often every rule is tried,
+ * matches and replaces tokens, and how long every step of a parse takes.
+ *
+ * Rules are named after the context of their translation, that does not
+ * depend on the locale.
+ */
+class ParserStatistics
+{
+    public:
+        struct RuleStatistics {
+            QString name;
+            QString stage;
+            qint64 attempts;        // Positions at which the rule was tried
+            qint64 matches;         // Matches given to the pass of the rule
+            qint64 replacements;    // Matches accepted by the pass
+        };
+
+        struct StepStatistics {
+            QString name;
+            QVector<qint64> bucket_counts;  // Not cumulative, the last bucket is +Inf
+            qint64 count;
+            qint64 sum_nsecs;
+        };
+
+    public:
+        const QList<RuleStatistics> &rules() const;
+        const QList<StepStatistics> &steps() const;
+
+        QString toOpenMetrics() const;
+
+        // Upper bounds, in nanoseconds, of the buckets of the histograms
+        static QVector<qint64> bucketBounds();
+
+    private:
+        friend class StatisticsCollector;
+
+        QList<RuleStatistics> rule_statistics;
+        QList<StepStatistics> step_statistics;
+};
+
+/**
+ * Counters of a parser, updated by the threads using it.
+ *
+ * Every thread has its own shard of the counters. A shard is only locked
+ * while a counter is updated or the shard is read by snapshot(), so the
+ * threads never wait for each other. The shard of a thread that exits is
+ * kept, and given to the next new thread.
+ */
+class StatisticsCollector
+{
+    public:
+        enum {
+            BucketCount = 16
+        };
+
+        struct RuleCounters {
+            RuleCounters() : attempts(0), matches(0), replacements(0) {}
+
+            qint64 attempts;
+            qint64 matches;
+            qint64 replacements;
+        };
+
+        struct Histogram {
+            Histogram() : count(0), sum_nsecs(0)
+            {
+                for (int i=0; i<BucketCount; ++i) {
+                    buckets[i] = 0;
+                }
+            }
+
+            qint64 buckets[BucketCount];
+            qint64 count;
+            qint64 sum_nsecs;
+        };
+
+        class Shard
+        {
+            public:
+                void addAttempts(int rule, int attempts)
+                {
+                    QMutexLocker locker(&mutex);
+
+                    rules[rule].attempts += attempts;
+                }
+
+                void addMatch(int rule, bool replaced)
+                {
+                    QMutexLocker locker(&mutex);
+
+                    rules[rule].matches += 1;
+                    rules[rule].replacements += (replaced ? 1 : 0);
+                }
+
+                void addLatency(int step, qint64 nsecs);
+
+            private:
+                friend class StatisticsCollector;
+
+                QMutex mutex;
+                QVector<RuleCounters> rules;
+                QVector<Histogram> steps;
+        };
+
+    public:
+        StatisticsCollector();
+        StatisticsCollector(const StatisticsCollector &other);
+        ~StatisticsCollector();
+
+        void addRule(const QString &name, const QString &stage);
+        int ruleCount() const;
+        void setSteps(const QStringList &names);
+
+        void setEnabled(bool enabled);
+        bool isEnabled() const;
+
+        // Shard of the current thread, or 0 if disabled
+        Shard *shard() const;
+
+        void addLatency(int step, qint64 nsecs);
+
+        ParserStatistics snapshot() const;
+
+    private:
+        struct ShardRegistry;
+        struct ThreadShards;
+
+        StatisticsCollector &operator=(const StatisticsCollector &other);
+
+    private:
+        QAtomicInt enabled;
+        int id;                 // Key of the collector in ThreadShards
+        QStringList rule_names;
+        QStringList rule_stages;
+        QStringList step_names;
+
+        QSharedPointer<ShardRegistry> registry;
+};
+
+#endif
\ No newline at end of file
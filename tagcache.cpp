@@ -0,0 +1,213 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "tagcache.h"
+
+#include <QMutexLocker>
+#include <QThread>
+
+TagCache::TagCache(TagSource *source)
+: source(source),
+  loaded(0),
+  active(0),
+  version(0),
+  update_count(0)
+{
+    if (source) {
+        source->setListener(this);
+    }
+}
+
+TagCache::~TagCache()
+{
+    if (source) {
+        source->setListener(0);
+    }
+}
+
+void TagCache::setSource(TagSource *source)
+{
+    if (this->source) {
+        this->source->setListener(0);
+    }
+
+    source->setListener(this);
+
+    QMutexLocker locker(&writer_mutex);
+
+    this->source = source;
+
+    if (int(loaded)) {
+        Update reset;
+
+        reset.kind = Update::Reset;
+        reset.tags = source->loadTags();
+
+        update(reset);
+    }
+}
+
+QUrl TagCache::tag(const QString &label, Qt::CaseSensitivity cs) const
+{
+    int v = beginRead();
+    QUrl rs = snapshots[int(active)].find(label, cs);
+
+    endRead(v);
+    return rs;
+}
+
+QList<QPair<QString, QUrl> > TagCache::tagsWithPrefix(const QString &prefix, int max_count) const
+{
+    int v = beginRead();
+    QList<QPair<QString, QUrl> > rs = snapshots[int(active)].findPrefix(prefix, max_count);
+
+    endRead(v);
+    return rs;
+}
+
+int TagCache::generation() const
+{
+    return update_count;
+}
+
+int TagCache::beginRead() const
+{
+    if (!int(loaded)) {
+        load();
+    }
+
+    // The counter is incremented before the active snapshot is read, so that
+    // the writer knows that this snapshot may be in use.
+    int v = version;
+
+    readers[v].ref();
+    return v;
+}
+
+void TagCache::endRead(int version) const
+{
+    readers[version].deref();
+}
+
+void TagCache::tagAdded(const QUrl &tag, const QString &label)
+{
+    tagRenamed(tag, label);
+}
+
+void TagCache::tagRenamed(const QUrl &tag, const QString &label)
+{
+    QMutexLocker locker(&writer_mutex);
+
+    if (!int(loaded)) {
+        // The tag will be read when the cache is loaded
+        return;
+    }
+
+    Update set_label;
+
+    set_label.kind = Update::SetLabel;
+    set_label.tag = tag;
+    set_label.label = label;
+
+    update(set_label);
+}
+
+void TagCache::tagRemoved(const QUrl &tag)
+{
+    QMutexLocker locker(&writer_mutex);
+
+    if (!int(loaded)) {
+        return;
+    }
+
+    Update remove;
+
+    remove.kind = Update::Remove;
+    remove.tag = tag;
+
+    update(remove);
+}
+
+void TagCache::load() const
+{
+    QMutexLocker locker(&writer_mutex);
+
+    if (int(loaded)) {
+        return;
+    }
+
+    Update reset;
+
+    reset.kind = Update::Reset;
+
+    if (source) {
+        reset.tags = source->loadTags();
+    }
+
+    apply(snapshots[0], reset);
+    apply(snapshots[1], reset);
+
+    loaded.fetchAndStoreOrdered(1);
+}
+
+void TagCache::update(const Update &update) const
+{
+    // Update the snapshot not used by the readers, and make it active
+    int previous = active;
+
+    apply(snapshots[1 - previous], update);
+    active.fetchAndStoreOrdered(1 - previous);
+    update_count.ref();
+
+    // Wait for the readers that may still use the previous snapshot. New
+    // readers are sent to the other counter, so that the wait always ends.
+    int v = version;
+
+    waitForReaders(1 - v);
+    version.fetchAndStoreOrdered(1 - v);
+    waitForReaders(v);
+
+    // Nobody reads the previous snapshot anymore
+    apply(snapshots[previous], update);
+}
+
+void TagCache::waitForReaders(int version) const
+{
+    while (int(readers[version]) != 0) {
+        QThread::yieldCurrentThread();
+    }
+}
+
+void TagCache::apply(TagIndex &index, const Update &update)
+{
+    switch (update.kind)
+    {
+        case Update::SetLabel:
+            index.setLabel(update.tag, update.label);
+            break;
+
+        case Update::Remove:
+            index.remove(update.tag);
+            break;
+
+        case Update::Reset:
+            index.reset(update.tags);
+            break;
+    }
+}
@@ -0,0 +1,93 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __TAGCACHE_H__
+#define __TAGCACHE_H__
+
+#include "tagsource.h"
+#include "tagindex.h"
+
+#include <QString>
+#include <QUrl>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QMutex>
+#include <QAtomicInt>
+
+/**
+ * Tags indexed by label, read by the parsing threads without locking.
+ *
+ * Two snapshots of the index are kept. Readers use the active one, while an
+ * update is applied to the other one, which is then made active. Once the
+ * readers of the previous snapshot are gone, the update is applied to it too
+ * (left-right scheme). Updates are serialized and come from the tag source,
+ * that is loaded on first use. The cache is empty until a source is set.
+ */
+class TagCache : public TagSource::Listener
+{
+    public:
+        explicit TagCache(TagSource *source);
+        virtual ~TagCache();
+
+        void setSource(TagSource *source);
+
+        QUrl tag(const QString &label, Qt::CaseSensitivity cs = Qt::CaseSensitive) const;
+        QList<QPair<QString, QUrl> > tagsWithPrefix(const QString &prefix, int max_count) const;
+        int generation() const;
+
+        virtual void tagAdded(const QUrl &tag, const QString &label);
+        virtual void tagRenamed(const QUrl &tag, const QString &label);
+        virtual void tagRemoved(const QUrl &tag);
+
+    private:
+        struct Update {
+            enum Kind {
+                SetLabel,
+                Remove,
+                Reset
+            };
+
+            Kind kind;
+            QUrl tag;
+            QString label;
+            QHash<QUrl, QString> tags;      // Reset
+        };
+
+        void load() const;
+        int beginRead() const;
+        void endRead(int version) const;
+        void update(const Update &update) const;
+        void waitForReaders(int version) const;
+
+        static void apply(TagIndex &index, const Update &update);
+
+    private:
+        TagSource *source;
+
+        mutable QMutex writer_mutex;
+        mutable TagIndex snapshots[2];
+        mutable QAtomicInt loaded;
+        mutable QAtomicInt active;          // Snapshot used by the readers
+        mutable QAtomicInt version;         // Counter incremented by the readers
+        mutable QAtomicInt readers[2];
+        mutable QAtomicInt update_count;    // Incremented once an update is visible
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,323 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "tagindex.h"
+
+#include <QtAlgorithms>
+
+#include <string.h>
+
+TagIndex::TagIndex()
+: unused_chars(0)
+{
+}
+
+void TagIndex::reset(const QHash<QUrl, QString> &tags)
+{
+    labels.clear();
+    folded_labels.clear();
+    uris.clear();
+    entries.clear();
+    by_label.clear();
+    by_uri.clear();
+    unused_chars = 0;
+
+    entries.reserve(tags.count());
+
+    for (QHash<QUrl, QString>::const_iterator it = tags.constBegin(); it != tags.constEnd(); ++it) {
+        addEntry(it.key().toEncoded(), it.value());
+    }
+
+    // Sort the entries once, instead of inserting them one by one
+    by_label.resize(entries.count());
+    by_uri.resize(entries.count());
+
+    for (int i=0; i<entries.count(); ++i) {
+        by_label[i] = i;
+        by_uri[i] = i;
+    }
+
+    LabelLessThan label_less_than = {this};
+    UriLessThan uri_less_than = {this};
+
+    qSort(by_label.begin(), by_label.end(), label_less_than);
+    qSort(by_uri.begin(), by_uri.end(), uri_less_than);
+}
+
+void TagIndex::setLabel(const QUrl &tag, const QString &label)
+{
+    QByteArray uri = tag.toEncoded();
+    int pos = uriLowerBound(uri);
+
+    if (pos < by_uri.count() && compareUri(by_uri.at(pos), uri) == 0) {
+        // Rename an existing tag, its old label is not used anymore
+        int entry = by_uri.at(pos);
+        Entry &e = entries[entry];
+
+        removeFromLabels(entry);
+        unused_chars += e.label_length;
+
+        e.label = labels.size();
+        e.label_length = label.size();
+        labels.append(label);
+        folded_labels.append(label.toCaseFolded());
+
+        insertInLabels(entry);
+    } else {
+        int entry = addEntry(uri, label);
+
+        by_uri.insert(pos, entry);
+        insertInLabels(entry);
+    }
+
+    if (unused_chars > labels.size() / 2) {
+        compact();
+    }
+}
+
+void TagIndex::remove(const QUrl &tag)
+{
+    QByteArray uri = tag.toEncoded();
+    int pos = uriLowerBound(uri);
+
+    if (pos == by_uri.count() || compareUri(by_uri.at(pos), uri) != 0) {
+        return;
+    }
+
+    int entry = by_uri.at(pos);
+
+    removeFromLabels(entry);
+    by_uri.remove(pos);
+    unused_chars += entries.at(entry).label_length;
+
+    if (unused_chars > labels.size() / 2) {
+        compact();
+    }
+}
+
+QUrl TagIndex::find(const QString &label, Qt::CaseSensitivity cs) const
+{
+    QString folded = label.toCaseFolded();
+
+    // The labels differing only by their case are next to each other
+    for (int i=labelLowerBound(folded); i<by_label.count(); ++i) {
+        int entry = by_label.at(i);
+
+        if (foldedLabel(entry) != folded) {
+            break;
+        }
+
+        if (cs == Qt::CaseInsensitive || this->label(entry) == label) {
+            const Entry &e = entries.at(entry);
+
+            return QUrl::fromEncoded(QByteArray(uris.constData() + e.uri, e.uri_length));
+        }
+    }
+
+    return QUrl();
+}
+
+QList<QPair<QString, QUrl> > TagIndex::findPrefix(const QString &prefix, int max_count) const
+{
+    QList<QPair<QString, QUrl> > rs;
+    QString folded = prefix.toCaseFolded();
+
+    for (int i=labelLowerBound(folded); i<by_label.count() && rs.count() < max_count; ++i) {
+        int entry = by_label.at(i);
+
+        if (!foldedLabel(entry).startsWith(folded)) {
+            break;
+        }
+
+        const Entry &e = entries.at(entry);
+
+        rs.append(qMakePair(
+            label(entry).toString(),
+            QUrl::fromEncoded(QByteArray(uris.constData() + e.uri, e.uri_length))
+        ));
+    }
+
+    return rs;
+}
+
+int TagIndex::count() const
+{
+    return by_uri.count();
+}
+
+qint64 TagIndex::memoryUsage() const
+{
+    return qint64(labels.capacity()) * sizeof(QChar) +
+           qint64(folded_labels.capacity()) * sizeof(QChar) +
+           qint64(uris.capacity()) +
+           qint64(entries.capacity()) * sizeof(Entry) +
+           qint64(by_label.capacity() + by_uri.capacity()) * sizeof(int);
+}
+
+bool TagIndex::LabelLessThan::operator()(int a, int b) const
+{
+    int c = QStringRef::compare(index->foldedLabel(a), index->foldedLabel(b));
+
+    if (c != 0) {
+        return c < 0;
+    }
+
+    return QStringRef::compare(index->label(a), index->label(b)) < 0;
+}
+
+bool TagIndex::UriLessThan::operator()(int a, int b) const
+{
+    const Entry &e = index->entries.at(b);
+
+    return index->compareUri(a, QByteArray::fromRawData(index->uris.constData() + e.uri, e.uri_length)) < 0;
+}
+
+QStringRef TagIndex::label(int entry) const
+{
+    const Entry &e = entries.at(entry);
+
+    return QStringRef(&labels, e.label, e.label_length);
+}
+
+QStringRef TagIndex::foldedLabel(int entry) const
+{
+    const Entry &e = entries.at(entry);
+
+    return QStringRef(&folded_labels, e.label, e.label_length);
+}
+
+int TagIndex::compareUri(int entry, const QByteArray &uri) const
+{
+    const Entry &e = entries.at(entry);
+    int c = memcmp(uris.constData() + e.uri, uri.constData(), qMin(e.uri_length, uri.size()));
+
+    return (c != 0 ? c : e.uri_length - uri.size());
+}
+
+int TagIndex::labelLowerBound(const QString &folded) const
+{
+    int first = 0;
+    int last = by_label.count();
+
+    while (first < last) {
+        int middle = (first + last) / 2;
+
+        if (QStringRef::compare(foldedLabel(by_label.at(middle)), folded) < 0) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+
+    return first;
+}
+
+int TagIndex::uriLowerBound(const QByteArray &uri) const
+{
+    int first = 0;
+    int last = by_uri.count();
+
+    while (first < last) {
+        int middle = (first + last) / 2;
+
+        if (compareUri(by_uri.at(middle), uri) < 0) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+
+    return first;
+}
+
+int TagIndex::addEntry(const QByteArray &uri, const QString &label)
+{
+    Entry e;
+
+    e.label = labels.size();
+    e.label_length = label.size();
+    e.uri = uris.size();
+    e.uri_length = uri.size();
+
+    // Simple case folding keeps the length of the string
+    labels.append(label);
+    folded_labels.append(label.toCaseFolded());
+    uris.append(uri);
+
+    entries.append(e);
+    return entries.count() - 1;
+}
+
+void TagIndex::removeFromLabels(int entry)
+{
+    QString folded = foldedLabel(entry).toString();
+
+    for (int i=labelLowerBound(folded); i<by_label.count(); ++i) {
+        if (by_label.at(i) == entry) {
+            by_label.remove(i);
+            break;
+        }
+    }
+}
+
+void TagIndex::insertInLabels(int entry)
+{
+    LabelLessThan label_less_than = {this};
+    QVector<int>::iterator it = qUpperBound(by_label.begin(), by_label.end(), entry, label_less_than);
+
+    by_label.insert(it, entry);
+}
+
+void TagIndex::compact()
+{
+    // Copy the live entries, in URI order so that by_uri stays sorted
+    QString new_labels;
+    QString new_folded_labels;
+    QByteArray new_uris;
+    QVector<Entry> new_entries;
+    QVector<int> new_numbers(entries.count(), -1);
+
+    new_entries.reserve(by_uri.count());
+
+    for (int i=0; i<by_uri.count(); ++i) {
+        int entry = by_uri.at(i);
+        Entry e = entries.at(entry);
+
+        new_labels.append(label(entry));
+        new_folded_labels.append(foldedLabel(entry));
+        new_uris.append(uris.constData() + e.uri, e.uri_length);
+
+        e.label = new_labels.size() - e.label_length;
+        e.uri = new_uris.size() - e.uri_length;
+
+        new_numbers[entry] = new_entries.count();
+        new_entries.append(e);
+        by_uri[i] = i;
+    }
+
+    for (int i=0; i<by_label.count(); ++i) {
+        by_label[i] = new_numbers.at(by_label.at(i));
+    }
+
+    labels = new_labels;
+    folded_labels = new_folded_labels;
+    uris = new_uris;
+    entries = new_entries;
+    unused_chars = 0;
+}
@@ -0,0 +1,103 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __TAGINDEX_H__
+#define __TAGINDEX_H__
+
+#include <QString>
+#include <QStringRef>
+#include <QByteArray>
+#include <QUrl>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QVector>
+
+/**
+ * Compact index of tag labels.
+ *
+ * The labels, their case-folded form and the tag URIs are stored in three
+ * flat buffers. Two sorted arrays of entry numbers give the tags by folded
+ * label and by URI, so that exact, case-insensitive and prefix lookups are
+ * binary searches, and a tag costs a few dozens of bytes plus its label and
+ * URI.
+ *
+ * Removed and renamed tags leave unused bytes in the buffers, that are given
+ * back when they become larger than the live data.
+ */
+class TagIndex
+{
+    public:
+        TagIndex();
+
+        void reset(const QHash<QUrl, QString> &tags);
+        void setLabel(const QUrl &tag, const QString &label);
+        void remove(const QUrl &tag);
+
+        QUrl find(const QString &label, Qt::CaseSensitivity cs = Qt::CaseSensitive) const;
+        QList<QPair<QString, QUrl> > findPrefix(const QString &prefix, int max_count) const;
+
+        int count() const;
+        qint64 memoryUsage() const;
+
+    private:
+        struct Entry {
+            int label;          // Offset of the label in labels and folded_labels
+            int label_length;
+            int uri;            // Offset of the URI in uris
+            int uri_length;
+        };
+
+        struct LabelLessThan {
+            const TagIndex *index;
+            bool operator()(int a, int b) const;
+        };
+        struct UriLessThan {
+            const TagIndex *index;
+            bool operator()(int a, int b) const;
+        };
+        friend struct LabelLessThan;
+        friend struct UriLessThan;
+
+        QStringRef label(int entry) const;
+        QStringRef foldedLabel(int entry) const;
+        int compareUri(int entry, const QByteArray &uri) const;
+
+        int labelLowerBound(const QString &folded) const;
+        int uriLowerBound(const QByteArray &uri) const;
+        int findUri(const QByteArray &uri) const;
+
+        int addEntry(const QByteArray &uri, const QString &label);
+        void removeFromLabels(int entry);
+        void insertInLabels(int entry);
+        void compact();
+
+    private:
+        QString labels;
+        QString folded_labels;
+        QByteArray uris;
+
+        QVector<Entry> entries;
+        QVector<int> by_label;
+        QVector<int> by_uri;
+
+        int unused_chars;
+};
+
+#endif
\ No newline at end of file
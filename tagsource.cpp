@@ -0,0 +1,109 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "tagsource.h"
+
+#include <QMutexLocker>
+
+TagSource::Listener::~Listener()
+{
+}
+
+TagSource::TagSource()
+: listener(0)
+{
+}
+
+TagSource::~TagSource()
+{
+}
+
+void TagSource::setListener(Listener *listener)
+{
+    QMutexLocker locker(&listener_mutex);
+
+    this->listener = listener;
+}
+
+void TagSource::notifyAdded(const QUrl &tag, const QString &label)
+{
+    QMutexLocker locker(&listener_mutex);
+
+    if (listener) {
+        listener->tagAdded(tag, label);
+    }
+}
+
+void TagSource::notifyRenamed(const QUrl &tag, const QString &label)
+{
+    QMutexLocker locker(&listener_mutex);
+
+    if (listener) {
+        listener->tagRenamed(tag, label);
+    }
+}
+
+void TagSource::notifyRemoved(const QUrl &tag)
+{
+    QMutexLocker locker(&listener_mutex);
+
+    if (listener) {
+        listener->tagRemoved(tag);
+    }
+}
+
+void MemoryTagSource::setTag(const QUrl &tag, const QString &label)
+{
+    bool renamed;
+
+    {
+        QMutexLocker locker(&mutex);
+
+        renamed = tags.contains(tag);
+        tags.insert(tag, label);
+    }
+
+    if (renamed) {
+        notifyRenamed(tag, label);
+    } else {
+        notifyAdded(tag, label);
+    }
+}
+
+void MemoryTagSource::removeTag(const QUrl &tag)
+{
+    bool removed;
+
+    {
+        QMutexLocker locker(&mutex);
+
+        removed = (tags.remove(tag) != 0);
+    }
+
+    if (removed) {
+        notifyRemoved(tag);
+    }
+}
+
+QHash<QUrl, QString> MemoryTagSource::loadTags()
+{
+    QMutexLocker locker(&mutex);
+
+    return tags;
+}
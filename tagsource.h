@@ -0,0 +1,80 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __TAGSOURCE_H__
+#define __TAGSOURCE_H__
+
+#include <QString>
+#include <QUrl>
+#include <QHash>
+#include <QMutex>
+
+/**
+ * Source of the tags known by the parser: gives the label of every tag and
+ * notifies a listener when tags are added, renamed or removed.
+ */
+class TagSource
+{
+    public:
+        class Listener
+        {
+            public:
+                virtual ~Listener();
+
+                virtual void tagAdded(const QUrl &tag, const QString &label) = 0;
+                virtual void tagRenamed(const QUrl &tag, const QString &label) = 0;
+                virtual void tagRemoved(const QUrl &tag) = 0;
+        };
+
+    public:
+        TagSource();
+        virtual ~TagSource();
+
+        virtual QHash<QUrl, QString> loadTags() = 0;
+
+        void setListener(Listener *listener);
+
+    protected:
+        void notifyAdded(const QUrl &tag, const QString &label);
+        void notifyRenamed(const QUrl &tag, const QString &label);
+        void notifyRemoved(const QUrl &tag);
+
+    private:
+        QMutex listener_mutex;
+        Listener *listener;
+};
+
+/**
+ * Tags kept in memory, used in place of the Nepomuk model when the parser is
+ * tested or benchmarked.
+ */
+class MemoryTagSource : public TagSource
+{
+    public:
+        void setTag(const QUrl &tag, const QString &label);
+        void removeTag(const QUrl &tag);
+
+        virtual QHash<QUrl, QString> loadTags();
+
+    private:
+        QMutex mutex;
+        QHash<QUrl, QString> tags;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,374 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "token.h"
+#include "pass_dateperiods.h"
+#include "datetimespec.h"
+
+#include <nepomuk2/literalterm.h>
+#include <nepomuk2/resourceterm.h>
+#include <nepomuk2/resourcetypeterm.h>
+#include <nepomuk2/property.h>
+#include <nepomuk2/class.h>
+#include <soprano/literalvalue.h>
+
+#include <klocalizedstring.h>
+
+static const qint64 msecs_per_day = 24LL * 60LL * 60LL * 1000LL;
+
+Token::Token()
+: kind(Invalid),
+  position(0),
+  length(0),
+  integer(0),
+  real(0.0),
+  period(0),
+  offset(false),
+  comparison(false),
+  comparator(Nepomuk2::Query::ComparisonTerm::Equal)
+{
+}
+
+Token Token::fromString(const QString &value)
+{
+    Token token;
+
+    token.kind = String;
+    token.string = value;
+    token.key = normalize(value);
+
+    return token;
+}
+
+Token Token::fromInteger(qint64 value)
+{
+    Token token;
+
+    token.kind = Integer;
+    token.integer = value;
+
+    return token;
+}
+
+Token Token::fromDouble(double value)
+{
+    Token token;
+
+    token.kind = Double;
+    token.real = value;
+
+    return token;
+}
+
+Token Token::fromDateTime(const QDateTime &value)
+{
+    Token token;
+
+    token.kind = DateTime;
+    token.integer =
+        qint64(value.date().toJulianDay()) * msecs_per_day +
+        qint64(QTime(0, 0).msecsTo(value.time()));
+
+    return token;
+}
+
+Token Token::fromDateTimeSpec(const DateTimeSpec &spec)
+{
+    Token token;
+
+    token.kind = DateTime;
+    token.date_spec = QSharedPointer<DateTimeSpec>(new DateTimeSpec(spec));
+
+    return token;
+}
+
+Token Token::fromDatePeriod(int period, bool offset, int value)
+{
+    Token token;
+
+    token.kind = DatePeriod;
+    token.period = period;
+    token.offset = offset;
+    token.integer = value;
+
+    return token;
+}
+
+Token Token::fromResourceType(const QUrl &type)
+{
+    Token token;
+
+    token.kind = ResourceType;
+    token.url = type;
+
+    return token;
+}
+
+Token Token::fromResource(const QUrl &uri)
+{
+    Token token;
+
+    token.kind = Resource;
+    token.url = uri;
+
+    return token;
+}
+
+Token Token::fromSubquery(const QVector<Token> &tokens)
+{
+    Token token;
+    int end_position = 0;
+
+    token.kind = Subquery;
+    token.subquery = QSharedPointer<QVector<Token> >(new QVector<Token>(tokens));
+    token.position = 1 << 30;
+
+    Q_FOREACH(const Token &child, tokens) {
+        token.position = qMin(token.position, child.position);
+        end_position = qMax(end_position, child.position + child.length);
+    }
+
+    token.length = qMax(0, end_position - token.position);
+
+    return token;
+}
+
+bool Token::isValid() const
+{
+    return kind != Invalid;
+}
+
+bool Token::isLiteral() const
+{
+    return !comparison && (kind == String || kind == Integer || kind == Double || kind == DateTime);
+}
+
+quint32 Token::literalTypes(bool comparison)
+{
+    // Kinds accepted by isLiteral()
+    return typeBit(String, comparison) | typeBit(Integer, comparison) |
+           typeBit(Double, comparison) | typeBit(DateTime, comparison);
+}
+
+bool Token::isComparison() const
+{
+    return comparison;
+}
+
+bool Token::operator==(const Token &other) const
+{
+    // Subqueries are compared by identity, comparing them would cost more
+    // than what is saved by finding them equal
+    return kind == other.kind &&
+           position == other.position &&
+           length == other.length &&
+           integer == other.integer &&
+           real == other.real &&
+           string == other.string &&
+           url == other.url &&
+           period == other.period &&
+           offset == other.offset &&
+           (date_spec == other.date_spec ||
+               (date_spec && other.date_spec && *date_spec == *other.date_spec)) &&
+           subquery == other.subquery &&
+           comparison == other.comparison &&
+           comparator == other.comparator &&
+           property == other.property;
+}
+
+bool Token::operator!=(const Token &other) const
+{
+    return !(*this == other);
+}
+
+void Token::setPosition(int position, int length)
+{
+    this->position = position;
+    this->length = length;
+}
+
+void Token::setPosition(const Token &other)
+{
+    position = other.position;
+    length = other.length;
+}
+
+void Token::setComparison(const QUrl &property, Nepomuk2::Query::ComparisonTerm::Comparator comparator)
+{
+    this->comparison = true;
+    this->property = property;
+    this->comparator = comparator;
+}
+
+void Token::resolveDateTime(const Calendar &calendar, const QDateTime &now)
+{
+    if (kind != DateTime || !date_spec) {
+        return;
+    }
+
+    QDateTime value = date_spec->resolve(calendar, now);
+
+    integer =
+        qint64(value.date().toJulianDay()) * msecs_per_day +
+        qint64(QTime(0, 0).msecsTo(value.time()));
+    date_spec.clear();
+}
+
+QString Token::toString() const
+{
+    switch (kind)
+    {
+        case String:
+            return string;
+        case Integer:
+            return QString::number(integer);
+        case Double:
+            return QString::number(real);
+        case DateTime:
+            return toDateTime().toString(Qt::ISODate);
+        default:
+            return QString();
+    }
+}
+
+QString Token::toKey() const
+{
+    if (kind == String) {
+        return key;
+    }
+
+    return normalize(toString());
+}
+
+QString Token::normalize(const QString &text)
+{
+    static const bool fold_diacritics = (i18nc(
+        "Set to 1 if the words of queries in this language are often written without their accents or diacritics",
+        "0"
+    ) == QLatin1String("1"));
+
+    // toCaseFolded() shares the data of text when it is already folded
+    QString folded = text.toCaseFolded();
+
+    if (!fold_diacritics) {
+        return folded;
+    }
+
+    // Remove the marks of the decomposed characters
+    QString decomposed = folded.normalized(QString::NormalizationForm_D);
+    QString rs;
+
+    rs.reserve(decomposed.size());
+
+    for (int i=0; i<decomposed.size(); ++i) {
+        QChar c = decomposed.at(i);
+
+        if (c.category() != QChar::Mark_NonSpacing) {
+            rs.append(c);
+        }
+    }
+
+    return rs;
+}
+
+qint64 Token::toInteger() const
+{
+    switch (kind)
+    {
+        case Integer:
+            return integer;
+        case Double:
+            return qint64(real);
+        case String:
+            return string.toLongLong();
+        default:
+            return 0;
+    }
+}
+
+QDateTime Token::toDateTime() const
+{
+    if (kind != DateTime || date_spec) {
+        return QDateTime();
+    }
+
+    return QDateTime(
+        QDate::fromJulianDay(int(integer / msecs_per_day)),
+        QTime(0, 0).addMSecs(int(integer % msecs_per_day))
+    );
+}
+
+Nepomuk2::Query::Term Token::toTerm() const
+{
+    Nepomuk2::Query::Term value;
+
+    switch (kind)
+    {
+        case Invalid:
+            return value;
+        case String:
+            value = Nepomuk2::Query::LiteralTerm(string);
+            break;
+        case Integer:
+            value = Nepomuk2::Query::LiteralTerm(qlonglong(integer));
+            break;
+        case Double:
+            value = Nepomuk2::Query::LiteralTerm(real);
+            break;
+        case DateTime:
+            value = Nepomuk2::Query::LiteralTerm(toDateTime());
+            break;
+        case DatePeriod:
+            value = Nepomuk2::Query::ComparisonTerm(
+                PassDatePeriods::propertyUrl(PassDatePeriods::Period(period), offset),
+                Nepomuk2::Query::LiteralTerm(int(integer)),
+                Nepomuk2::Query::ComparisonTerm::Equal
+            );
+            break;
+        case ResourceType:
+            value = Nepomuk2::Query::ResourceTypeTerm(Nepomuk2::Types::Class(url));
+            break;
+        case Resource:
+            value = Nepomuk2::Query::ResourceTerm(url);
+            break;
+        case Subquery:
+            // Fused by fuseTerms(), that gives the result to toComparisonTerm()
+            return value;
+    }
+
+    value.setPosition(position, length);
+
+    return toComparisonTerm(value);
+}
+
+Nepomuk2::Query::Term Token::toComparisonTerm(const Nepomuk2::Query::Term &value) const
+{
+    if (!comparison) {
+        return value;
+    }
+
+    Nepomuk2::Query::ComparisonTerm rs(
+        property.isEmpty() ? Nepomuk2::Types::Property() : Nepomuk2::Types::Property(property),
+        value,
+        comparator
+    );
+    rs.setPosition(position, length);
+
+    return rs;
+}
@@ -0,0 +1,134 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __TOKEN_H__
+#define __TOKEN_H__
+
+#include <nepomuk2/term.h>
+#include <nepomuk2/comparisonterm.h>
+
+#include <QString>
+#include <QUrl>
+#include <QDateTime>
+#include <QVector>
+#include <QSharedPointer>
+
+class DateTimeSpec;
+class Calendar;
+
+/**
+ * Compact representation of a term of the query, on which the passes work.
+ *
+ * Tokens are plain values stored contiguously in a QVector. They are converted
+ * to Nepomuk2::Query::Term objects only when the final query is built by
+ * fuseTerms().
+ */
+struct Token
+{
+    enum Kind {
+        Invalid = 0,
+        String,
+        Integer,
+        Double,
+        DateTime,
+        DatePeriod,     // Value or offset of a period, before date-times are folded
+        ResourceType,
+        Resource,
+        Subquery        // Tokens of a subquery, fused with the query by fuseTerms()
+    };
+
+    // Types accepted by a capture of a pattern, as a mask of type bits. The
+    // comparisons have their own bits, passes rarely accept both.
+    enum {
+        ComparisonTypeShift = 16,
+        AnyType = 0xffffffff
+    };
+
+    static quint32 typeBit(Kind kind, bool comparison = false);
+    static quint32 literalTypes(bool comparison = false);
+
+    static QString normalize(const QString &text);
+
+    Token();
+
+    static Token fromString(const QString &value);
+    static Token fromInteger(qint64 value);
+    static Token fromDouble(double value);
+    static Token fromDateTime(const QDateTime &value);
+    static Token fromDateTimeSpec(const DateTimeSpec &spec);
+    static Token fromDatePeriod(int period, bool offset, int value);
+    static Token fromResourceType(const QUrl &type);
+    static Token fromResource(const QUrl &uri);
+    static Token fromSubquery(const QVector<Token> &tokens);
+
+    bool isValid() const;
+    bool isLiteral() const;
+    bool isComparison() const;
+    quint32 typeBit() const;
+
+    bool operator==(const Token &other) const;
+    bool operator!=(const Token &other) const;
+
+    void setPosition(int position, int length);
+    void setPosition(const Token &other);
+    void setComparison(const QUrl &property, Nepomuk2::Query::ComparisonTerm::Comparator comparator);
+    void resolveDateTime(const Calendar &calendar, const QDateTime &now);
+
+    QString toString() const;
+    QString toKey() const;
+    qint64 toInteger() const;
+    QDateTime toDateTime() const;
+
+    Nepomuk2::Query::Term toTerm() const;
+    Nepomuk2::Query::Term toComparisonTerm(const Nepomuk2::Query::Term &value) const;
+
+    Kind kind;
+    int position;
+    int length;
+
+    // Value of the token, depending on its kind
+    qint64 integer;         // Integer and DatePeriod, milliseconds since Julian day 0 for DateTime
+    double real;
+    QString string;
+    QString key;            // Normalized string, compared with the words of the rules
+    QUrl url;               // ResourceType and Resource
+    int period;             // PassDatePeriods::Period of a DatePeriod
+    bool offset;            // The value of a DatePeriod is relative
+    QSharedPointer<DateTimeSpec> date_spec;         // DateTime not resolved yet
+    QSharedPointer<QVector<Token> > subquery;
+
+    // Comparison of a property with the value of the token
+    bool comparison;
+    Nepomuk2::Query::ComparisonTerm::Comparator comparator;
+    QUrl property;
+};
+
+Q_DECLARE_TYPEINFO(Token, Q_MOVABLE_TYPE);
+
+inline quint32 Token::typeBit(Kind kind, bool comparison)
+{
+    return 1u << (int(kind) + (comparison ? int(ComparisonTypeShift) : 0));
+}
+
+inline quint32 Token::typeBit() const
+{
+    return typeBit(kind, comparison);
+}
+
+#endif
@@ -0,0 +1,165 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#include "tokenizer.h"
+
+Tokenizer::Tokenizer(const QString &separators)
+: separators(separators)
+{
+    // Classify the Latin-1 characters once, the others are rare in queries
+    for (int i=0; i<256; ++i) {
+        QChar c = QChar(ushort(i));
+
+        if (c == QLatin1Char('"')) {
+            latin1_classes[i] = Quote;
+        } else if (c.isSpace()) {
+            latin1_classes[i] = Space;
+        } else if (separators.contains(c)) {
+            latin1_classes[i] = Separator;
+        } else {
+            latin1_classes[i] = Word;
+        }
+    }
+}
+
+Tokenizer::CharClass Tokenizer::charClass(QChar c) const
+{
+    ushort code = c.unicode();
+
+    if (code < 256) {
+        return CharClass(latin1_classes[code]);
+    } else if (c.isSpace()) {
+        return Space;
+    } else if (separators.contains(c)) {
+        return Separator;
+    } else {
+        return Word;
+    }
+}
+
+QVector<Tokenizer::Span> Tokenizer::tokenize(const QString &text, bool split_separators, int from) const
+{
+    QVector<Span> spans;
+    const QChar *data = text.constData();
+    int size = text.size();
+    bool between_quotes = false;
+    Span span;
+
+    span.length = 0;
+
+    for (int i=from; i<size; ++i) {
+        CharClass cls = charClass(data[i]);
+
+        if (cls == Quote) {
+            between_quotes = !between_quotes;
+
+            if (span.length > 0) {
+                span.has_quotes = true;
+            }
+        } else if (between_quotes || cls == Word || (cls == Separator && !split_separators)) {
+            if (span.length == 0) {
+                // Start of a new word, save its position in the text
+                span.position = i;
+                span.has_quotes = false;
+            }
+
+            span.length = i - span.position + 1;
+        } else {
+            // A word may be empty if more than one space are found in block in the input
+            if (span.length > 0) {
+                spans.append(span);
+                span.length = 0;
+            }
+
+            // Add a separator, if any
+            if (cls == Separator) {
+                Span separator;
+
+                separator.position = i;
+                separator.length = 1;
+                separator.has_quotes = false;
+
+                spans.append(separator);
+            }
+        }
+    }
+
+    if (span.length > 0) {
+        spans.append(span);
+    }
+
+    return spans;
+}
+
+int Tokenizer::restartPosition(const QString &text, bool split_separators, int end) const
+{
+    // The last space or separator before end ends the words before it, and
+    // tokenizing the text from it gives the same words after it
+    const QChar *data = text.constData();
+    int position = end - 1;
+
+    for (; position > 0; --position) {
+        CharClass cls = charClass(data[position]);
+
+        if (cls == Space || (cls == Separator && split_separators)) {
+            break;
+        }
+    }
+
+    if (position <= 0) {
+        return 0;
+    }
+
+    // It must not be between quotes
+    bool between_quotes = false;
+
+    for (int i=0; i<position; ++i) {
+        if (charClass(data[i]) == Quote) {
+            between_quotes = !between_quotes;
+        }
+    }
+
+    return (between_quotes ? 0 : position);
+}
+
+const QString &Tokenizer::separatorCharacters() const
+{
+    return separators;
+}
+
+QString Tokenizer::spanText(const QString &text, const Span &span)
+{
+    if (!span.has_quotes) {
+        return text.mid(span.position, span.length);
+    }
+
+    // Quotes in the middle of a word are not part of it
+    QString rs;
+    const QChar *data = text.constData() + span.position;
+
+    rs.reserve(span.length);
+
+    for (int i=0; i<span.length; ++i) {
+        if (data[i] != QLatin1Char('"')) {
+            rs.append(data[i]);
+        }
+    }
+
+    return rs;
+}
@@ -0,0 +1,72 @@
+/* This file is part of the Nepomuk query parser
+   Copyright (c) 2013 Denis Steckelmacher <steckdenis@yahoo.fr>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public
+   License version 2.1 as published by the Free Software Foundation,
+   or any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public License
+   along with this library; see the file COPYING.LIB.  If not, write to
+   the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __TOKENIZER_H__
+#define __TOKENIZER_H__
+
+#include <QString>
+#include <QVector>
+
+/**
+ * Splits a query or a pattern into words and separators.
+ *
+ * The words are returned as spans into the original string, they are copied
+ * only when a token is built from them. Spaces and separators are classified
+ * using a table built once from the locale-specific list of separators.
+ *
+ * Text between double quotes is kept in a single word, the quotes themselves
+ * are not part of the word.
+ */
+class Tokenizer
+{
+    public:
+        struct Span {
+            int position;
+            int length;
+            bool has_quotes;            // Quotes have to be removed from the text
+        };
+
+    public:
+        explicit Tokenizer(const QString &separators);
+
+        QVector<Span> tokenize(const QString &text, bool split_separators, int from = 0) const;
+        int restartPosition(const QString &text, bool split_separators, int end) const;
+
+        const QString &separatorCharacters() const;
+
+        static QString spanText(const QString &text, const Span &span);
+
+    private:
+        enum CharClass {
+            Word = 0,
+            Space,
+            Separator,
+            Quote
+        };
+
+        CharClass charClass(QChar c) const;
+
+    private:
+        QString separators;
+        unsigned char latin1_classes[256];
+};
+
+Q_DECLARE_TYPEINFO(Tokenizer::Span, Q_PRIMITIVE_TYPE);
+
+#endif
\ No newline at end of file
@@ -19,6 +19,7 @@
 
 #include "utils.h"
 #include "pass_dateperiods.h"
+#include "calendar.h"
 
 #include <nepomuk2/literalterm.h>
 #include <nepomuk2/andterm.h>
@@ -33,38 +34,67 @@
 #include <soprano/literalvalue.h>
 
 #include <klocale.h>
-#include <kcalendarsystem.h>
 #include <klocalizedstring.h>
 
-QString termStringValue(const Nepomuk2::Query::Term &term)
+#include <QList>
+
+QString tokenStringValue(const Token &token)
 {
-    if (!term.isLiteralTerm()) {
+    if (token.comparison || token.kind != Token::String) {
         return QString();
     }
 
-    Soprano::LiteralValue value = term.toLiteralTerm().value();
+    return token.string;
+}
 
-    if (value.isString()) {
-        return value.toString();
-    } else {
+QString tokenStringKey(const Token &token)
+{
+    if (token.comparison || token.kind != Token::String) {
         return QString();
     }
+
+    return token.key;
 }
 
-bool termIntValue(const Nepomuk2::Query::Term& term, int &value)
+bool tokenIntValue(const Token &token, int &value)
 {
-    if (!term.isLiteralTerm()) {
+    if (token.comparison || token.kind != Token::Integer) {
         return false;
     }
 
-    Soprano::LiteralValue v = term.toLiteralTerm().value();
+    value = int(token.integer);
+    return true;
+}
+
+void replaceTokens(QVector<Token> &tokens,
+                   int index,
+                   int length,
+                   const QVector<Token> &replacement,
+                   int start_position,
+                   int end_position)
+{
+    // Replace tokens index..index+length with replacement. The tokens that
+    // are kept are overwritten in place, the vector is resized only once.
+    int count = replacement.count();
+
+    if (count < length) {
+        tokens.remove(index + count, length - count);
+    } else if (count > length) {
+        tokens.insert(index + length, count - length, Token());
+    }
 
-    if (!v.isInt() && !v.isInt64()) {
-        return false;
+    for (int i=0; i<count; ++i) {
+        tokens[index + i] = replacement.at(i);
     }
 
-    value = v.toInt();
-    return true;
+    // If the pass returned only one replacement token, set its position. If
+    // more tokens are returned, the pass must handle positions itself
+    if (count == 1) {
+        tokens[index].setPosition(
+            start_position,
+            end_position - start_position
+        );
+    }
 }
 
 static Nepomuk2::Query::AndTerm intervalComparison(const Nepomuk2::Types::Property &prop,
@@ -86,190 +116,423 @@ static Nepomuk2::Query::AndTerm intervalComparison(const Nepomuk2::Types::Proper
     return total;
 }
 
-static Nepomuk2::Query::AndTerm dateTimeComparison(const Nepomuk2::Types::Property &prop,
-                                                   const Nepomuk2::Query::LiteralTerm &term)
+void dateTimeInterval(const Token &token,
+                      const Calendar &calendar,
+                      QDateTime &start_date_time,
+                      QDateTime &end_date_time)
 {
-    KCalendarSystem *cal = KCalendarSystem::create(KGlobal::locale()->calendarSystem());
-    QDateTime start_date_time = term.value().toDateTime();
+    start_date_time = token.toDateTime();
+    end_date_time = start_date_time;
 
     QDate start_date(start_date_time.date());
-    QTime start_time(start_date_time.time());
-    QDate end_date(start_date);
-    QTime end_time(start_time);
-    PassDatePeriods::Period last_defined_period = (PassDatePeriods::Period)(start_time.msec());
+    PassDatePeriods::Period last_defined_period = (PassDatePeriods::Period)(start_date_time.time().msec());
 
     switch (last_defined_period)
     {
         case PassDatePeriods::Year:
-            end_date = cal->addYears(start_date, 1);
+            end_date_time.setDate(calendar.addYears(start_date, 1));
             break;
         case PassDatePeriods::Month:
-            end_date = cal->addMonths(start_date, 1);
+            end_date_time.setDate(calendar.addMonths(start_date, 1));
             break;
         case PassDatePeriods::Week:
-            end_date = cal->addDays(start_date, cal->dayOfWeek(end_date));
+            end_date_time.setDate(calendar.addDays(start_date, calendar.daysInWeek(start_date)));
             break;
         case PassDatePeriods::DayOfWeek:
         case PassDatePeriods::Day:
-            end_date = cal->addDays(start_date, 1);
+            end_date_time.setDate(calendar.addDays(start_date, 1));
             break;
 
         case PassDatePeriods::Hour:
-            end_time.addSecs(60 * 60);
+            end_date_time = start_date_time.addSecs(60 * 60);
             break;
         case PassDatePeriods::Minute:
-            end_time.addSecs(60);
+            end_date_time = start_date_time.addSecs(60);
             break;
         case PassDatePeriods::Second:
-            end_time.addSecs(1);
+            end_date_time = start_date_time.addSecs(1);
             break;
         default:
             break;
     }
+}
+
+void sizeInterval(qint64 size, qint64 &min, qint64 &max)
+{
+    min = size * 80LL / 100LL;
+    max = size * 120LL / 100LL;
+}
+
+void updateDefaultProperties(const QUrl &type, QUrl &datetime_property, QUrl &filesize_property)
+{
+    if (type == Nepomuk2::Vocabulary::NMO::Message()) {
+        datetime_property = Nepomuk2::Vocabulary::NMO::receivedDate();
+        filesize_property = Nepomuk2::Vocabulary::NIE::contentSize();
+    } else if (type == Nepomuk2::Vocabulary::NFO::FileDataObject() ||
+               type == Nepomuk2::Vocabulary::NFO::Document()) {
+        datetime_property = Nepomuk2::Vocabulary::NFO::fileLastModified();
+        filesize_property = Nepomuk2::Vocabulary::NFO::fileSize();
+    }
+}
+
+static Nepomuk2::Query::AndTerm dateTimeComparison(const Nepomuk2::Types::Property &prop,
+                                                   const Token &token,
+                                                   const Calendar &calendar)
+{
+    QDateTime start_date_time;
+    QDateTime end_date_time;
+
+    dateTimeInterval(token, calendar, start_date_time, end_date_time);
+
+    Nepomuk2::Query::LiteralTerm start_term(start_date_time);
+    Nepomuk2::Query::LiteralTerm end_term(end_date_time);
 
-    Nepomuk2::Query::LiteralTerm end_term(QDateTime(end_date, end_time));
-    end_term.setPosition(term);
+    start_term.setPosition(token.position, token.length);
+    end_term.setPosition(start_term);
 
     return intervalComparison(
         prop,
-        term,
+        start_term,
         end_term
     );
 }
 
-Nepomuk2::Query::Term fuseTerms(const QList<Nepomuk2::Query::Term> &terms, int first_term_index, int& end_term_index)
+void resolveDateTimes(QVector<Token> &tokens, const Calendar &calendar, const QDateTime &now)
 {
-    Nepomuk2::Query::Term fused_term;
-    bool build_and = true;
-    bool build_not = false;
-
-    QUrl default_filesize_property = Nepomuk2::Vocabulary::NIE::byteSize();
-    QUrl default_datetime_property = Nepomuk2::Vocabulary::NIE::created();
-
-    QString and_string = i18n("and");
-    QString or_string = i18n("or");
-    QString not_string = i18n("not");
-
-    // Fuse terms in nested AND and OR terms. "a AND b OR c" is fused as
-    // "(a AND b) OR c"
-    for (end_term_index=first_term_index; end_term_index<terms.size(); ++end_term_index) {
-        Nepomuk2::Query::Term term = terms.at(end_term_index);
-
-        if (term.isComparisonTerm()) {
-            Nepomuk2::Query::ComparisonTerm &comparison = term.toComparisonTerm();
-
-            if (comparison.comparator() == Nepomuk2::Query::ComparisonTerm::Equal &&
-                comparison.subTerm().isLiteralTerm() &&
-                comparison.subTerm().toLiteralTerm().value().isDateTime())
-            {
-                // We try to compare exactly with a date-time, which is impossible
-                // (except if you want to find documents edited precisely at
-                // the millisecond you want)
-                // Build a comparison against an interval
-                term = dateTimeComparison(comparison.property(), comparison.subTerm().toLiteralTerm());
-            }
-        } else if (term.isResourceTypeTerm()) {
-            QUrl uri = term.toResourceTypeTerm().type().uri();
-
-            if (uri == Nepomuk2::Vocabulary::NMO::Message()) {
-                default_datetime_property = Nepomuk2::Vocabulary::NMO::receivedDate();
-                default_filesize_property = Nepomuk2::Vocabulary::NIE::contentSize();
-            } else if (uri == Nepomuk2::Vocabulary::NFO::FileDataObject() ||
-                       uri == Nepomuk2::Vocabulary::NFO::Document()) {
-                default_datetime_property = Nepomuk2::Vocabulary::NFO::fileLastModified();
-                default_filesize_property = Nepomuk2::Vocabulary::NFO::fileSize();
-            }
-        } else if (term.isLiteralTerm()) {
-            Soprano::LiteralValue value = term.toLiteralTerm().value();
+    for (int i=0; i<tokens.count(); ++i) {
+        const Token &token = tokens.at(i);
+
+        if (token.kind == Token::DateTime && token.date_spec) {
+            tokens[i].resolveDateTime(calendar, now);
+        } else if (token.kind == Token::Subquery) {
+            // The subquery may be shared with a template, resolve a copy of it
+            QVector<Token> subquery = *token.subquery;
+
+            resolveDateTimes(subquery, calendar, now);
+            tokens[i].subquery = QSharedPointer<QVector<Token> >(new QVector<Token>(subquery));
+        }
+    }
+}
+
+FuseKeywords::FuseKeywords()
+: and_string(Token::normalize(i18n("and"))),
+  or_string(Token::normalize(i18n("or"))),
+  not_string(Token::normalize(i18n("not")))
+{
+}
+
+FuseKeywords::Keyword FuseKeywords::keyword(const Token &token) const
+{
+    const QString &content = token.key;
+
+    if (content == or_string) {
+        return Or;
+    } else if (content == and_string ||
+               content == QLatin1String("+")) {
+        return And;
+    } else if (content == QLatin1String("!") ||
+               content == not_string ||
+               content == QLatin1String("-")) {
+        return Not;
+    } else if (content == QLatin1String("(")) {
+        return OpeningParenthesis;
+    } else if (content == QLatin1String(")")) {
+        return ClosingParenthesis;
+    } else if (content.size() <= 2) {
+        // Ignore small terms, they are typically "to", "a", etc.
+        // NOTE: Some locales may want to have this filter removed
+        return IgnoredWord;
+    }
+
+    return NoKeyword;
+}
+
+/*
+ * Terms of a level of the query being fused: the query itself, a
+ * parenthesized group or a subquery.
+ *
+ * The terms joined by the same connective are collected in a list, and the
+ * AndTerm or OrTerm is only built when the connective changes or the level
+ * ends. "a AND b OR c" is fused as "(a AND b) OR c".
+ */
+struct FuseLevel
+{
+    enum Group {
+        NoGroup,
+        AndGroup,
+        OrGroup
+    };
+
+    FuseLevel(const QVector<Token> *tokens, int index, const Token *subquery)
+    : tokens(tokens),
+      index(index),
+      subquery(subquery),
+      group(NoGroup),
+      start_position(0),
+      end_position(0),
+      ignored_parentheses(0),
+      build_and(true),
+      build_not(false),
+      default_filesize_property(Nepomuk2::Vocabulary::NIE::byteSize()),
+      default_datetime_property(Nepomuk2::Vocabulary::NIE::created())
+    {}
+
+    void addTerm(Nepomuk2::Query::Term term);
+    void openGroup(Group kind);
+    Nepomuk2::Query::Term fusedTerm() const;
+
+    const QVector<Token> *tokens;
+    int index;
+    const Token *subquery;                      // Token of the subquery fused by this level
+
+    Nepomuk2::Query::Term term;                 // Fused term if no group is open
+    QList<Nepomuk2::Query::Term> operands;      // Sub-terms of the open group
+    Group group;
+    int start_position;
+    int end_position;
+
+    int ignored_parentheses;                    // Opened beyond FuseKeywords::MaxDepth
+    bool build_and;
+    bool build_not;
+    QUrl default_filesize_property;
+    QUrl default_datetime_property;
+};
+
+void FuseLevel::addTerm(Nepomuk2::Query::Term added)
+{
+    // Negate the term if needed
+    if (build_not) {
+        Nepomuk2::Query::Term negated =
+            Nepomuk2::Query::NegationTerm::negateTerm(added);
 
-            if (value.isDateTime()) {
+        negated.setPosition(added);
+
+        added = negated;
+    }
+
+    if (group == NoGroup && !term.isValid()) {
+        term = added;
+        start_position = added.position();
+        end_position = added.position() + added.length();
+    } else {
+        Group kind = (build_and ? AndGroup : OrGroup);
+
+        if (group != kind) {
+            openGroup(kind);
+        }
+
+        operands.append(added);
+        start_position = qMin(start_position, added.position());
+        end_position = qMax(end_position, added.position() + added.length());
+    }
+
+    if (group == NoGroup) {
+        term.setPosition(start_position, end_position - start_position);
+    } else if (!added.isValid()) {
+        // The validity of the group now depends on the invalid term, build it
+        term = fusedTerm();
+        operands.clear();
+        group = NoGroup;
+    }
+
+    // Default to AND, and don't invert terms
+    build_and = true;
+    build_not = false;
+}
+
+void FuseLevel::openGroup(Group kind)
+{
+    static const Nepomuk2::Query::AndTerm empty_and;
+    static const Nepomuk2::Query::OrTerm empty_or;
+
+    Nepomuk2::Query::Term fused = fusedTerm();
+
+    operands.clear();
+    operands.reserve(tokens->count() - index + 1);
+
+    if (kind == AndGroup && fused.isAndTerm()) {
+        // Terms already joined by the same connective are extended
+        operands = fused.toAndTerm().subTerms();
+    } else if (kind == OrGroup && fused.isOrTerm()) {
+        operands = fused.toOrTerm().subTerms();
+    } else {
+        // New group, that has the position of a new term until the added
+        // term is merged in it
+        const Nepomuk2::Query::Term &empty = (kind == AndGroup ?
+            static_cast<const Nepomuk2::Query::Term &>(empty_and) :
+            static_cast<const Nepomuk2::Query::Term &>(empty_or));
+
+        operands.append(fused);
+        start_position = empty.position();
+        end_position = empty.position() + empty.length();
+    }
+
+    term = Nepomuk2::Query::Term();
+    group = kind;
+}
+
+Nepomuk2::Query::Term FuseLevel::fusedTerm() const
+{
+    Nepomuk2::Query::Term rs;
+
+    switch (group)
+    {
+        case NoGroup:
+            return term;
+        case AndGroup:
+            rs = Nepomuk2::Query::AndTerm(operands);
+            break;
+        case OrGroup:
+            rs = Nepomuk2::Query::OrTerm(operands);
+            break;
+    }
+
+    rs.setPosition(start_position, end_position - start_position);
+
+    return rs;
+}
+
+Nepomuk2::Query::Term fuseTerms(const QVector<Token> &tokens,
+                                int first_token_index,
+                                int &end_token_index,
+                                const Calendar &calendar,
+                                const FuseKeywords &keywords)
+{
+    // Parentheses and subqueries are fused with an explicit stack of levels,
+    // so that deeply nested queries cannot exhaust the call stack
+    QVector<FuseLevel> levels;
+
+    levels.reserve(4);
+    levels.append(FuseLevel(&tokens, first_token_index, 0));
+
+    while (true) {
+        FuseLevel &level = levels.last();
+        Nepomuk2::Query::Term term;
+        bool level_done = (level.index >= level.tokens->count());
+
+        if (!level_done) {
+            const Token &token = level.tokens->at(level.index);
+
+            if (token.kind == Token::Subquery) {
+                // The fused subquery has the position of its terms
+                levels.append(FuseLevel(token.subquery.data(), 0, &token));
+                continue;
+            } else if (token.isComparison()) {
+                if (token.comparator == Nepomuk2::Query::ComparisonTerm::Equal &&
+                    token.kind == Token::DateTime)
+                {
+                    // We try to compare exactly with a date-time, which is impossible
+                    // (except if you want to find documents edited precisely at
+                    // the millisecond you want)
+                    // Build a comparison against an interval
+                    term = dateTimeComparison(token.property, token, calendar);
+                } else {
+                    term = token.toTerm();
+                }
+            } else if (token.kind == Token::ResourceType) {
+                updateDefaultProperties(token.url,
+                                        level.default_datetime_property,
+                                        level.default_filesize_property);
+
+                term = token.toTerm();
+            } else if (token.kind == Token::DateTime) {
                 // Default property for date-times
                 term = dateTimeComparison(
-                    default_datetime_property,
-                    term.toLiteralTerm()
+                    level.default_datetime_property,
+                    token,
+                    calendar
                 );
-            } else if (value.isInt() || value.isInt64()) {
-                long long int v = value.toInt64();
-                Nepomuk2::Query::LiteralTerm min(v * 80LL / 100LL);
-                Nepomuk2::Query::LiteralTerm max(v * 120LL / 100LL);
-
-                min.setPosition(term);
-                max.setPosition(term);
-
-                term = intervalComparison(default_filesize_property, min, max);
-            } else if (value.isString()) {
-                QString content = value.toString().toLower();
-
-                if (content == or_string) {
-                    // Consume the OR term, the next term will be ORed with the previous
-                    build_and = false;
-                    continue;
-                } else if (content == and_string ||
-                           content == QLatin1String("+")) {
-                    // Consume the AND term
-                    build_and = true;
-                    continue;
-                } else if (content == QLatin1String("!") ||
-                           content == not_string ||
-                           content == QLatin1String("-")) {
-                    // Consume the negation
-                    build_not = true;
-                    continue;
-                } else if (content == QLatin1String("(")) {
-                    // Fuse the nested query
-                    term = fuseTerms(terms, end_term_index + 1, end_term_index);
-                } else if (content == QLatin1String(")")) {
-                    // Done
-                    return fused_term;
-                } else if (content.size() <= 2) {
-                    // Ignore small terms, they are typically "to", "a", etc.
-                    // NOTE: Some locales may want to have this filter removed
-                    continue;
+            } else if (token.kind == Token::Integer) {
+                qint64 min_size;
+                qint64 max_size;
+
+                sizeInterval(token.integer, min_size, max_size);
+
+                Nepomuk2::Query::LiteralTerm min(min_size);
+                Nepomuk2::Query::LiteralTerm max(max_size);
+
+                min.setPosition(token.position, token.length);
+                max.setPosition(token.position, token.length);
+
+                term = intervalComparison(level.default_filesize_property, min, max);
+            } else if (token.kind == Token::String) {
+                switch (keywords.keyword(token))
+                {
+                    case FuseKeywords::Or:
+                        // Consume the OR term, the next term will be ORed with the previous
+                        level.build_and = false;
+                        ++level.index;
+                        continue;
+                    case FuseKeywords::And:
+                        // Consume the AND term
+                        level.build_and = true;
+                        ++level.index;
+                        continue;
+                    case FuseKeywords::Not:
+                        // Consume the negation
+                        level.build_not = true;
+                        ++level.index;
+                        continue;
+                    case FuseKeywords::OpeningParenthesis:
+                        if (levels.count() < FuseKeywords::MaxDepth) {
+                            // Fuse the nested query
+                            levels.append(FuseLevel(level.tokens, level.index + 1, 0));
+                        } else {
+                            // Too deep, the group is fused in this level
+                            ++level.ignored_parentheses;
+                            ++level.index;
+                        }
+                        continue;
+                    case FuseKeywords::ClosingParenthesis:
+                        if (level.ignored_parentheses > 0) {
+                            --level.ignored_parentheses;
+                            ++level.index;
+                            continue;
+                        }
+
+                        // Done
+                        level_done = true;
+                        break;
+                    case FuseKeywords::IgnoredWord:
+                        ++level.index;
+                        continue;
+                    case FuseKeywords::NoKeyword:
+                        term = token.toTerm();
+                        break;
                 }
+            } else {
+                term = token.toTerm();
             }
         }
 
-        // Negate the term if needed
-        if (build_not) {
-            Nepomuk2::Query::Term negated =
-                Nepomuk2::Query::NegationTerm::negateTerm(term);
+        if (level_done) {
+            Nepomuk2::Query::Term fused = level.fusedTerm();
+            int index = level.index;
+            const Token *subquery = level.subquery;
 
-            negated.setPosition(term);
+            if (levels.count() == 1) {
+                end_token_index = index;
+                return fused;
+            }
 
-            term = negated;
-        }
+            levels.removeLast();
 
-        // Add term to the fused term
-        if (!fused_term.isValid()) {
-            fused_term = term;
-        } else if (build_and) {
-            if (fused_term.isAndTerm()) {
-                fused_term.toAndTerm().addSubTerm(term);
-            } else {
-                fused_term = Nepomuk2::Query::AndTerm(fused_term, term);
-            }
-        } else {
-            if (fused_term.isOrTerm()) {
-                fused_term.toOrTerm().addSubTerm(term);
+            FuseLevel &parent = levels.last();
+
+            if (subquery) {
+                // The parent is still at the subquery token
+                parent.addTerm(subquery->toComparisonTerm(fused));
             } else {
-                fused_term = Nepomuk2::Query::OrTerm(fused_term, term);
+                // The parent continues after the closing parenthesis
+                parent.addTerm(fused);
+                parent.index = index;
             }
-        }
 
-        // Position information
-        int start_position = qMin(fused_term.position(), term.position());
-        int end_position = qMax(fused_term.position() + fused_term.length(),
-                                term.position() + term.length());
-
-        fused_term.setPosition(
-            start_position,
-            end_position - start_position
-        );
+            ++parent.index;
+            continue;
+        }
 
-        // Default to AND, and don't invert terms
-        build_and = true;
-        build_not = false;
+        level.addTerm(term);
+        ++level.index;
     }
-
-    return fused_term;
 }
@@ -20,16 +20,71 @@
 #ifndef __UTILS_H__
 #define __UTILS_H__
 
+#include "token.h"
+
 #include <nepomuk2/term.h>
 
 #include <QString>
-#include <QList>
+#include <QVector>
+
+class Calendar;
+
+QString tokenStringValue(const Token &token);
+QString tokenStringKey(const Token &token);
+bool tokenIntValue(const Token &token, int &value);
+
+void replaceTokens(QVector<Token> &tokens,
+                   int index,
+                   int length,
+                   const QVector<Token> &replacement,
+                   int start_position,
+                   int end_position);
+
+void resolveDateTimes(QVector<Token> &tokens, const Calendar &calendar, const QDateTime &now);
+
+// Values matched by a date-time or a file size, and default properties of the
+// values following a type, shared by fuseTerms() and SparqlEmitter
+void dateTimeInterval(const Token &token,
+                      const Calendar &calendar,
+                      QDateTime &start_date_time,
+                      QDateTime &end_date_time);
+void sizeInterval(qint64 size, qint64 &min, qint64 &max);
+void updateDefaultProperties(const QUrl &type, QUrl &datetime_property, QUrl &filesize_property);
+
+/**
+ * Translated connectives of the query, resolved once when the parser is built
+ */
+struct FuseKeywords
+{
+    enum Keyword {
+        NoKeyword,
+        And,
+        Or,
+        Not,
+        OpeningParenthesis,
+        ClosingParenthesis,
+        IgnoredWord
+    };
+
+    // Deepest nesting of parentheses. Deeper parentheses are ignored like
+    // other short words, so that a query cannot open levels without bound.
+    enum {
+        MaxDepth = 64
+    };
+
+    FuseKeywords();
+
+    Keyword keyword(const Token &token) const;
 
-QString termStringValue(const Nepomuk2::Query::Term &term);
-bool termIntValue(const Nepomuk2::Query::Term &term, int &value);
+    QString and_string;
+    QString or_string;
+    QString not_string;
+};
 
-Nepomuk2::Query::Term fuseTerms(const QList<Nepomuk2::Query::Term> &terms,
-                                int first_term_index,
-                                int &end_term_index);
+Nepomuk2::Query::Term fuseTerms(const QVector<Token> &tokens,
+                                int first_token_index,
+                                int &end_token_index,
+                                const Calendar &calendar,
+                                const FuseKeywords &keywords);
 
 #endif
\ No newline at end of file